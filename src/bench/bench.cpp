@@ -0,0 +1,383 @@
+#include "input/fd_event_bus.hpp"
+#include "input/udev_subsystem.hpp"
+#include "input/evdev_subsystem.hpp"
+#include "input/math.hpp"
+#include "input/axis_kernels.hpp"
+#include "input/uinput_writer.hpp"
+#include "input/input_recording.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <new>
+#include <thread>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+// Synthetic throughput and latency benchmark.
+//   A producer thread writes Stadia-like controller frames into a pipe which is registered as a synthetic
+//   evdev device. Frames run through the full bus -> evdev -> frame callback -> UInputWriter path, with the
+//   output going to /dev/null. No real devices or permissions are required.
+//   With --replay, a recording is fed through the same path as fast as possible instead.
+
+// -----------------------------------------------------------------------------
+
+static std::atomic<uint64_t> allocation_count = 0;
+
+void* operator new(size_t size)
+{
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    if (auto ptr = malloc(size ?: 1)) return ptr;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept
+{
+    free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept
+{
+    free(ptr);
+}
+
+// -----------------------------------------------------------------------------
+
+namespace input::bench
+{
+    namespace chr = std::chrono;
+
+    struct Options
+    {
+        uint64_t frames = 2'000'000;
+        uint64_t warmup_frames = 10'000;
+        uint32_t reader_threads = 0;
+        uint32_t rate = 0; // Frames per second, 0 = as fast as possible
+        const char* replay = nullptr;
+        FdEventBusBackend backend = FdEventBusBackend::Epoll;
+
+        // Fail if anything allocates while forwarding frames after warmup
+        bool assert_no_alloc = false;
+
+        // Compare the axis kernels against their math.hpp counterparts instead of benchmarking
+        bool check_kernels = false;
+    };
+
+    static
+    auto parse_options(int argc, char* argv[]) -> Options
+    {
+        Options options;
+
+        for (int i = 1; i < argc; ++i) {
+            std::string_view arg = argv[i];
+            auto value = [&]() -> uint64_t {
+                if (++i >= argc) raise_error("Missing value for {}", arg);
+                return std::strtoull(argv[i], nullptr, 10);
+            };
+
+            if      (arg == "--frames")         options.frames = value();
+            else if (arg == "--warmup")         options.warmup_frames = value();
+            else if (arg == "--reader-threads") options.reader_threads = uint32_t(value());
+            else if (arg == "--rate")           options.rate = uint32_t(value());
+            else if (arg == "--io-uring")       options.backend = FdEventBusBackend::IoUring;
+            else if (arg == "--replay" && i + 1 < argc) options.replay = argv[++i];
+            else if (arg == "--assert-no-alloc") options.assert_no_alloc = true;
+            else if (arg == "--check-kernels")   options.check_kernels = true;
+            else {
+                log_info("Usage: {} [--frames N] [--warmup N] [--reader-threads N] [--rate FPS] [--io-uring] [--replay FILE] [--assert-no-alloc] [--check-kernels]", argv[0]);
+                std::exit(arg == "--help" ? EXIT_SUCCESS : EXIT_FAILURE);
+            }
+        }
+
+        return options;
+    }
+
+    // Sweeps each axis kernel across its input range with a spread of parameters, comparing every lane
+    //   against the scalar version in math.hpp. Returns the number of mismatches.
+    static
+    uint32_t check_kernels()
+    {
+        constexpr size_t count = axis_padded(2001);
+        constexpr float tolerance = 1e-4f;
+
+        uint32_t failures = 0;
+        auto expect = [&](const char* kernel, size_t lane, double got, double expected, double within) {
+            if (std::abs(got - expected) <= within) return;
+            if (failures++ < 16) log_error("  {}[{}]: got {}, expected {}", kernel, lane, got, expected);
+        };
+
+        std::vector<float> xs(count), ys(count), p0(count), p1(count);
+        auto sweep = [&](size_t i) { return -1.1f + 2.2f * float(i) / float(count - 1); };
+
+        // Normalize, over the full range of a byte axis and a signed 16 bit axis
+        {
+            std::vector<int32_t> raw(count);
+            for (size_t i = 0; i < count; ++i) {
+                auto [min, max] = (i & 1) ? std::pair(-32768, 32767) : std::pair(0, 255);
+                raw[i] = min + int32_t(int64_t(max - min) * int64_t(i) / int64_t(count - 1));
+                p0[i] = 2.f / float(max - min);
+                p1[i] = -1.f - float(min) * p0[i];
+            }
+            axes_normalize(raw, p0, p1, xs);
+            for (size_t i = 0; i < count; ++i) {
+                auto [min, max] = (i & 1) ? std::pair(-32768, 32767) : std::pair(0, 255);
+                expect("normalize", i, xs[i], maprange(raw[i], min, max, -1, 1), tolerance);
+            }
+        }
+
+        // Axial deadzone
+        for (size_t i = 0; i < count; ++i) {
+            xs[i] = sweep(i);
+            p0[i] = float(i % 5) * 0.05f;
+            p1[i] = float(i % 3) * 0.05f;
+        }
+        axes_deadzone(xs, p0, p1);
+        for (size_t i = 0; i < count; ++i) {
+            expect("deadzone", i, xs[i], deadzone(sweep(i), p0[i], p1[i]), tolerance);
+        }
+
+        // Radial deadzone, with y running opposite to x so every quadrant is covered
+        for (size_t i = 0; i < count; ++i) {
+            xs[i] = sweep(i);
+            ys[i] = sweep(count - 1 - i) * 0.5f;
+            p0[i] = 0.01f + float(i % 5) * 0.05f;
+            p1[i] = float(i % 3) * 0.05f;
+        }
+        axes_deadzone_radial(xs, ys, p0, p1);
+        for (size_t i = 0; i < count; ++i) {
+            auto expected = deadzone_radial(vec2(sweep(i), sweep(count - 1 - i) * 0.5f), p0[i], p1[i]);
+            expect("deadzone_radial.x", i, xs[i], expected.x, tolerance);
+            expect("deadzone_radial.y", i, ys[i], expected.y, tolerance);
+        }
+
+        // Gamma, on [-1, 1] only as the curves are never fed values outside it
+        for (size_t i = 0; i < count; ++i) {
+            xs[i] = std::clamp(sweep(i), -1.f, 1.f);
+            p0[i] = 0.5f + float(i % 7) * 0.5f;
+        }
+        axes_gamma(xs, p0);
+        for (size_t i = 0; i < count; ++i) {
+            expect("gamma", i, xs[i], gamma(std::clamp(sweep(i), -1.f, 1.f), p0[i]), tolerance);
+        }
+
+        // Rescale, onto a symmetric output axis and a unipolar one. Rounding may differ by one count
+        {
+            std::vector<int32_t> out(count);
+            for (size_t i = 0; i < count; ++i) {
+                xs[i] = sweep(i);
+                p0[i] = (i & 1) ? -32767.f : 0.f;
+                p1[i] = (i & 1) ? 32767.f : 255.f;
+            }
+            axes_rescale(xs, p0, p1, out);
+            for (size_t i = 0; i < count; ++i) {
+                expect("rescale", i, out[i], std::round(maprange(std::clamp(sweep(i), -1.f, 1.f), -1, 1, p0[i], p1[i])), 1);
+            }
+        }
+
+        return failures;
+    }
+
+    static
+    libevdev* create_source_device()
+    {
+        auto device = libevdev_new();
+        libevdev_set_name(device, "Synthetic Gamepad");
+        libevdev_set_id_bustype(device, BUS_VIRTUAL);
+        libevdev_set_id_vendor(device, 0x18d1);
+        libevdev_set_id_product(device, 0x9400);
+
+        input_absinfo stick = { .minimum = 1, .maximum = 255 };
+        input_absinfo trigger = { .minimum = 0, .maximum = 255 };
+        for (auto code : { ABS_X, ABS_Y, ABS_Z, ABS_RZ }) libevdev_enable_event_code(device, EV_ABS, code, &stick);
+        for (auto code : { ABS_GAS, ABS_BRAKE })          libevdev_enable_event_code(device, EV_ABS, code, &trigger);
+        for (auto code : { BTN_SOUTH, BTN_EAST, BTN_NORTH, BTN_WEST, BTN_TL, BTN_TR }) {
+            libevdev_enable_event_code(device, EV_KEY, code, nullptr);
+        }
+
+        return device;
+    }
+
+    // Writes frames of four stick axes, a trigger and an occasional button toggle, stamped with the
+    //   time of writing. With a rate set, frames are paced on absolute deadlines.
+    static
+    void produce_frames(int fd, const Options& options)
+    {
+        defer { close(fd); };
+
+        std::array<input_event, 7> frame;
+        auto next = chr::steady_clock::now();
+        auto period = options.rate ? chr::nanoseconds(1'000'000'000 / options.rate) : chr::nanoseconds(0);
+
+        for (uint64_t i = 0; i < options.frames; ++i) {
+            if (options.rate) {
+                next += period;
+                std::this_thread::sleep_until(next);
+            }
+
+            timespec ts;
+            clock_gettime(CLOCK_MONOTONIC, &ts);
+            timeval time { .tv_sec = ts.tv_sec, .tv_usec = ts.tv_nsec / 1000 };
+
+            uint32_t count = 0;
+            auto emit = [&](uint16_t type, uint16_t code, int32_t value) {
+                frame[count++] = input_event { .time = time, .type = type, .code = code, .value = value };
+            };
+
+            auto phase = int32_t(i & 255);
+            emit(EV_ABS, ABS_X,  1 + (phase * 3) % 255);
+            emit(EV_ABS, ABS_Y,  1 + (phase * 5) % 255);
+            emit(EV_ABS, ABS_Z,  1 + (phase * 7) % 255);
+            emit(EV_ABS, ABS_RZ, 1 + (phase * 11) % 255);
+            emit(EV_ABS, ABS_GAS, phase);
+            if ((i & 63) == 0) emit(EV_KEY, BTN_SOUTH, (i >> 6) & 1);
+            emit(EV_SYN, SYN_REPORT, 0);
+
+            auto bytes = std::as_bytes(std::span(frame.data(), count));
+            while (!bytes.empty()) {
+                auto written = write(fd, bytes.data(), bytes.size());
+                if (written < 0) {
+                    if (errno == EINTR) continue;
+                    raise_unix_error("write");
+                }
+                bytes = bytes.subspan(written);
+            }
+        }
+    }
+
+    // Forwards each frame through the same transform chain as the Stadia example
+
+    struct ForwardingSink
+    {
+        const Options& options;
+        FdEventBus* event_bus;
+        UInputWriter& writer;
+
+        uint64_t frames = 0;
+        uint64_t events = 0;
+        uint64_t warmup_allocations = 0;
+        uint64_t end_allocations = 0;
+        chr::steady_clock::time_point warmup_end;
+        chr::steady_clock::time_point end;
+        LatencyHistogram latency;
+
+        void operator()(EvInputDevice* device, EvDevInputDeviceEventType type, std::span<const input_event> frame, const EvDevState& state)
+        {
+            if (type == EvDevInputDeviceEventType::DeviceRemoved) {
+                end = chr::steady_clock::now();
+                end_allocations = allocation_count.load(std::memory_order_relaxed);
+                latency = device->get_latency();
+                event_bus->stop();
+                return;
+            }
+
+            // Measurement starts with the first frame after warmup, which with no warmup is the very first one
+            if (frames++ == options.warmup_frames) {
+                warmup_end = chr::steady_clock::now();
+                warmup_allocations = allocation_count.load(std::memory_order_relaxed);
+                events = 0;
+            }
+            events += frame.size();
+
+            auto& abs = state.abs;
+            auto wheel = radial_to_wheel(deadzone_radial(vec2(abs[ABS_Z], -abs[ABS_RZ]), 0.13, 0), 2.5, 2.25, 1.3);
+            auto stick = deadzone_radial(vec2(abs[ABS_X], -abs[ABS_Y]), 0.13, 0);
+            auto brake = gamma(maprange(abs[ABS_GAS], -1, 1, 0, 1), 2.0);
+
+            writer.emit(EV_ABS, ABS_X, int(wheel * 32767));
+            writer.emit(EV_ABS, ABS_Y, int(stick.y * 32767));
+            writer.emit(EV_ABS, ABS_Z, int(brake * 32767));
+            writer.emit(EV_KEY, BTN_TRIGGER, state.keys.test(BTN_SOUTH));
+            writer.sync();
+            writer.flush();
+        }
+    };
+
+    static
+    int cmain(int argc, char* argv[])
+    {
+        auto options = parse_options(argc, argv);
+
+        if (options.check_kernels) {
+            auto failures = check_kernels();
+            if (failures) {
+                log_error("Axis kernels: {} mismatches against math.hpp", failures);
+                return EXIT_FAILURE;
+            }
+            log_info("Axis kernels match math.hpp");
+            return EXIT_SUCCESS;
+        }
+
+        auto event_bus = FdEventBus::create(options.backend);
+        defer { unref(event_bus); };
+
+        // Never started, the synthetic device bypasses udev entirely
+        auto udev_subsystem = UDevSubsystem::create();
+        defer { unref(udev_subsystem); };
+
+        auto evdev_subsystem = EvDevSubsystem::create(event_bus, udev_subsystem, options.reader_threads);
+        defer { unref(evdev_subsystem); };
+
+        auto sink_fd = unix_check_n1(open("/dev/null", O_WRONLY | O_CLOEXEC));
+        defer { close(sink_fd); };
+        UInputWriter writer(sink_fd, event_bus);
+
+        // Declared before the device sources, so it outlives them
+        ForwardingSink sink { .options = options, .event_bus = event_bus, .writer = writer };
+
+        int fds[2] = { -1, -1 };
+        InputReplay* replay = nullptr;
+        defer { unref(replay); };
+
+        EvInputDevice* device;
+        if (options.replay) {
+            replay = InputReplay::create(event_bus, evdev_subsystem, options.replay, InputReplayMode::AsFastAsPossible);
+            device = replay->get_device();
+        } else {
+            unix_check_n1(pipe2(fds, O_CLOEXEC));
+            unix_check_n1(fcntl(fds[0], F_SETFL, O_NONBLOCK));
+            device = evdev_subsystem->add_synthetic_device(fds[0], create_source_device());
+        }
+
+        evdev_subsystem->register_input_device_frame_sink(device, sink);
+
+        log_info("Running {} frames ({} warmup), backend = {}, reader threads = {}, rate = {}",
+            options.replay ? std::format("[{}]", options.replay) : std::format("{}", options.frames), options.warmup_frames,
+            options.backend == FdEventBusBackend::IoUring ? "io_uring" : "epoll",
+            options.reader_threads,
+            options.rate ? std::format("{} fps", options.rate) : "unlimited"s);
+
+        std::jthread producer;
+        if (!options.replay) producer = std::jthread(produce_frames, fds[1], std::cref(options));
+        event_bus->run();
+
+        if (sink.frames <= options.warmup_frames) {
+            log_warn("Only {} frames received, not enough to measure past warmup", sink.frames);
+            return EXIT_FAILURE;
+        }
+
+        auto& latency = sink.latency;
+        auto measured = sink.frames - options.warmup_frames;
+        auto allocations = sink.end_allocations - sink.warmup_allocations;
+        auto seconds = chr::duration<double>(sink.end - sink.warmup_end).count();
+        auto us = [](uint64_t ns) { return double(ns) / 1000.0; };
+
+        log_info("Frames:      {} in {:.3f}s", measured, seconds);
+        log_info("Throughput:  {:.0f} frames/s, {:.0f} events/s", measured / seconds, sink.events / seconds);
+        log_info("Allocations: {} ({:.3f} per frame)", allocations, double(allocations) / measured);
+        log_info("Latency:     p50 = {:.1f}us p99 = {:.1f}us p99.9 = {:.1f}us max = {:.1f}us (all {} frames)",
+            us(latency.percentile(50)), us(latency.percentile(99)), us(latency.percentile(99.9)), us(latency.max), latency.total);
+
+        if (options.assert_no_alloc && allocations) {
+            log_error("Steady state allocated {} times, expected none", allocations);
+            return EXIT_FAILURE;
+        }
+
+        return EXIT_SUCCESS;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    return input::bench::cmain(argc, argv);
+}
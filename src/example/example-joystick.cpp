@@ -1,6 +1,10 @@
 #include "example.hpp"
 
 #include "input/math.hpp"
+#include "input/uinput_writer.hpp"
+#include "input/device_profile.hpp"
+#include "input/pipeline.hpp"
+#include "input/response_curve.hpp"
 
 #include <libevdev/libevdev-uinput.h>
 
@@ -11,6 +15,16 @@ namespace input::example
     static
     libevdev_uinput* joy_uinput = nullptr;
 
+    static
+    UInputWriter joy_writer;
+
+    // Both controllers report full state every frame, only changed codes are written to the virtual joystick
+    static
+    UInputStateWriter joy_state(&joy_writer);
+
+    // Zero writes changes as soon as a controller reports them, otherwise output is sent at this fixed rate
+    constexpr static auto joy_output_period = 0ms;
+
     static
     void create_virtual_joystick()
     {
@@ -39,6 +53,7 @@ namespace input::example
         libevdev_enable_event_code(virt_joystick, EV_KEY, BTN_TOP, nullptr);
 
         unix_check_ne(libevdev_uinput_create_from_device(virt_joystick, LIBEVDEV_UINPUT_OPEN_MANAGED, &joy_uinput));
+        joy_writer = UInputWriter(joy_uinput, event_bus);
     }
 
     static
@@ -49,63 +64,14 @@ namespace input::example
             return std::clamp(value, -1.0, 1.0) * 32767;
         };
 
-        unix_check_ne(libevdev_uinput_write_event(joy_uinput, EV_ABS, ABS_X, rescale(wheel)));
-        unix_check_ne(libevdev_uinput_write_event(joy_uinput, EV_ABS, ABS_Y,   throttle <= 0 ? -1 : rescale(throttle)));
-        unix_check_ne(libevdev_uinput_write_event(joy_uinput, EV_ABS, ABS_Z,      brake <= 0 ? -1 : rescale(brake)));
-        unix_check_ne(libevdev_uinput_write_event(joy_uinput, EV_ABS, ABS_RX, handbrake <= 0 ? -1 : rescale(handbrake)));
-        unix_check_ne(libevdev_uinput_write_event(joy_uinput, EV_KEY, BTN_TRIGGER, accept));
-        unix_check_ne(libevdev_uinput_write_event(joy_uinput, EV_KEY, BTN_THUMB, save));
-        unix_check_ne(libevdev_uinput_write_event(joy_uinput, EV_KEY, BTN_THUMB2, other));
-        unix_check_ne(libevdev_uinput_write_event(joy_uinput, EV_SYN, SYN_REPORT, 0));
-    };
-
-    static
-    auto maprange(double v, double in_low, double in_high, double out_low, double out_high, bool clamp = false) -> double
-    {
-        if (clamp) {
-            if (v < in_low) return out_low;
-            if (v > in_high) return out_high;
-        }
-        auto p = (v - in_low) / (in_high - in_low);
-        return p * (out_high - out_low) + out_low;
-    };
-
-    static
-    auto deadzone(double v, double inner, double outer) -> double
-    {
-        if (std::abs(v) < inner) return 0;
-        return std::copysign(std::min((std::abs(v) - inner) / (1.0 - inner - outer), 1.0), v);
-    };
-
-    static
-    auto deadzone_radial(vec2 pos, double inner, double outer) -> vec2
-    {
-        auto r = mag(pos);
-        if (r < inner) return vec2(0.0);
-
-        auto d = deadzone(r, inner, outer);
-
-        // Bump deadzone output, otherwise value flickers between 1.0 and 0.9999...
-        //   due to floating point precision limitations, which leads to rounding issues
-        d = std::nextafter(d, std::numeric_limits<double>::infinity());
-
-        return pos * (d / r);
-    };
-
-    static
-    auto gamma(double v, double g) -> double
-    {
-        return std::copysign(std::pow(std::abs(v), g), v);
-    };
-
-    static
-    auto radial_to_wheel(vec2 pos, double q_max, double r_gamma, double q_gamma) -> double
-    {
-        auto r = gamma(mag(pos), r_gamma);
-        auto q = std::atan2(pos.x, pos.y) / q_max;
-        q = std::clamp(q, -1.0, 1.0);
-        q = gamma(q, q_gamma);
-        return std::clamp(std::min(r, 1.0) * q, -1.0, 1.0);
+        joy_state.set(EV_ABS, ABS_X, rescale(wheel));
+        joy_state.set(EV_ABS, ABS_Y,   throttle <= 0 ? -1 : rescale(throttle));
+        joy_state.set(EV_ABS, ABS_Z,      brake <= 0 ? -1 : rescale(brake));
+        joy_state.set(EV_ABS, ABS_RX, handbrake <= 0 ? -1 : rescale(handbrake));
+        joy_state.set(EV_KEY, BTN_TRIGGER, accept);
+        joy_state.set(EV_KEY, BTN_THUMB, save);
+        joy_state.set(EV_KEY, BTN_THUMB2, other);
+        joy_state.commit();
     };
 
     static
@@ -138,120 +104,132 @@ namespace input::example
 #endif
     };
 
-    void init_joystick(int argc, char* argv[])
+    struct StadiaProfile
     {
-        create_virtual_joystick();
-
-#define INPUT_NOISY_JOYSTICKS 0
-
-        // Google Stadia Controller
-
-        evdev_subsystem->register_device_filter([](EvInputDevice* device) -> bool {
-            if (!device->has_gamepad() && !device->has_joystick()) return false;
-            if (device->get_vid() != 0x18d1 || device->get_pid() != 0x9400) return false;
-            log_info("Found joystick: {}", device->get_name());
-
-            device->get_udev_node()->parent->hide();
-            device->grab();
-
-            evdev_subsystem->register_input_device_event_callback(device, [](EvInputDevice* device, EvDevInputDeviceEventType type, input_event ev) {
-                if (type == EvDevInputDeviceEventType::DeviceRemoved) {
-                    log_debug("Joystick [{}] removed", device->get_name());
-                    return;
-                }
-
-                if (ev.type != EV_SYN || ev.code != SYN_REPORT) return;
-
-                std::array<double, 8> values{};
-                std::array<int, 8> abs_names { ABS_X, ABS_Y, ABS_Z, ABS_RZ, ABS_GAS, ABS_BRAKE, ABS_HAT0X, ABS_HAT0Y };
-                for (int i = 0; i < abs_names.size(); ++i) {
-                    auto info = libevdev_get_abs_info(device->get_device(), abs_names[i]);
-
-                    auto range = double(info->maximum - info->minimum);
-                    values[i] = (info->value - info->minimum) / range;
-                    values[i] = (values[i] * 2) - 1;
-                }
-
-                std::array<bool, 18> key{};
-                std::array<int, 18> key_names { KEY_VOLUMEDOWN, KEY_VOLUMEUP, KEY_PLAYPAUSE, BTN_SOUTH, BTN_EAST, BTN_NORTH, BTN_WEST, BTN_TL, BTN_TR,
-                    BTN_SELECT, BTN_START, BTN_MODE, BTN_THUMBL, BTN_THUMBR, BTN_TRIGGER_HAPPY1, BTN_TRIGGER_HAPPY2, BTN_TRIGGER_HAPPY3, BTN_TRIGGER_HAPPY4 };
-                for (int i = 0; i < key_names.size(); ++i) {
-                    key[i] = libevdev_get_event_value(device->get_device(), EV_KEY, key_names[i]);
-                }
+        static constexpr std::string_view name = "Google Stadia Controller";
+        static constexpr uint16_t vendor = 0x18d1;
+        static constexpr uint16_t product = 0x9400;
+
+        static constexpr std::array axes {
+            ProfileAxis{ABS_X}, ProfileAxis{ABS_Y},
+            ProfileAxis{ABS_Z}, ProfileAxis{ABS_RZ},
+            ProfileAxis{ABS_GAS, 0, 1}, ProfileAxis{ABS_BRAKE, 0, 1},
+            ProfileAxis{ABS_HAT0X}, ProfileAxis{ABS_HAT0Y},
+        };
 
-#if INPUT_NOISY_JOYSTICKS
-                std::string output;
-                for (auto& v : values) output += std::format(" {:5.2f}", v);
-                output += " --";
-                for (int i = 0; i < key_names.size(); ++i) {
-                    if (key[i]) output += std::format(" {}", i);
-                }
-                log_info("Stadia: {}", output);
-#endif
+        static constexpr std::array buttons {
+            KEY_VOLUMEDOWN, KEY_VOLUMEUP, KEY_PLAYPAUSE, BTN_SOUTH, BTN_EAST, BTN_NORTH, BTN_WEST, BTN_TL, BTN_TR,
+            BTN_SELECT, BTN_START, BTN_MODE, BTN_THUMBL, BTN_THUMBR, BTN_TRIGGER_HAPPY1, BTN_TRIGGER_HAPPY2, BTN_TRIGGER_HAPPY3, BTN_TRIGGER_HAPPY4,
+        };
+    };
 
-                auto wheel = radial_to_wheel(deadzone_radial(vec2(values[2], -values[3]), 0.13, 0), 2.5, 2.25, 1.3);
-                double throttle, brake, handbrake;
-                radial_to_throttle_brake(deadzone_radial(vec2(values[0], -values[1]), 0.13, 0), &throttle, &brake, &handbrake);
-                if (key[7]) handbrake = 1.0;
-                brake = std::min(1.0, brake + maprange(values[4], -1, 1, 0, 1));
+    // Both stick chains, tabulated over a controller's raw stick ranges when it is added, so frames never
+    //   evaluate sqrt, pow or atan2
+    struct StadiaCurves
+    {
+        ResponseCurve2D wheel;
+        ResponseCurve2D throttle, brake, handbrake;
 
-                auto a = key[3];
-                auto y = key[6];
-                auto right_shoulder = key[8];
+        explicit StadiaCurves(EvInputDevice* device)
+        {
+            auto evdev = device->get_device();
 
-                joy_report(wheel, throttle, brake, handbrake, a, right_shoulder, y);
+            wheel.build(*libevdev_get_abs_info(evdev, ABS_Z), *libevdev_get_abs_info(evdev, ABS_RZ), [](vec2 pos) {
+                return radial_to_wheel(deadzone_radial(vec2(pos.x, -pos.y), 0.13, 0), 2.5, 2.25, 1.3);
             });
 
-            return true;
-        });
-
-        // Taranis X9D
+            auto& left_x = *libevdev_get_abs_info(evdev, ABS_X);
+            auto& left_y = *libevdev_get_abs_info(evdev, ABS_Y);
+            auto pedal = [](vec2 pos, auto select) {
+                double throttle, brake, handbrake;
+                radial_to_throttle_brake(deadzone_radial(vec2(pos.x, -pos.y), 0.13, 0), &throttle, &brake, &handbrake);
+                return select(throttle, brake, handbrake);
+            };
+            throttle.build(left_x, left_y, [&](vec2 pos) { return pedal(pos, [](double t, double, double) { return t; }); });
+            brake.build(left_x, left_y, [&](vec2 pos) { return pedal(pos, [](double, double b, double) { return b; }); });
+            handbrake.build(left_x, left_y, [&](vec2 pos) { return pedal(pos, [](double, double, double h) { return h; }); });
+        }
+    };
 
-        evdev_subsystem->register_device_filter([&](EvInputDevice* device) -> bool {
-            if (!device->has_gamepad() && !device->has_joystick()) return false;
-            if (device->get_vid() != 0x0483 || device->get_pid() != 0x5710) return false;
-            log_info("Found joystick: {}", device->get_name());
+    struct TaranisProfile
+    {
+        static constexpr std::string_view name = "FrSky Taranis X9D";
+        static constexpr uint16_t vendor = 0x0483;
+        static constexpr uint16_t product = 0x5710;
+
+        static constexpr std::array axes {
+            ProfileAxis{ABS_X}, ProfileAxis{ABS_Y}, ProfileAxis{ABS_Z},
+            ProfileAxis{ABS_RX}, ProfileAxis{ABS_RY}, ProfileAxis{ABS_RZ},
+            ProfileAxis{ABS_THROTTLE},
+        };
 
-            device->get_udev_node()->parent->hide();
-            device->grab();
+        static constexpr std::array<uint16_t, 0> buttons {};
+    };
 
-            evdev_subsystem->register_input_device_event_callback(device, [](EvInputDevice* device, EvDevInputDeviceEventType type, input_event ev) {
-                if (type == EvDevInputDeviceEventType::DeviceRemoved) {
-                    log_debug("Joystick [{}] removed", device->get_name());
-                    return;
-                }
+    void init_joystick(int argc, char* argv[])
+    {
+        create_virtual_joystick();
+        joy_state.set_fixed_rate(event_bus, joy_output_period);
 
-                if (ev.type != EV_SYN || ev.code != SYN_REPORT) return;
+#define INPUT_NOISY_JOYSTICKS 0
 
-                std::array<double, 7> values{};
-                std::array<int, 7> abs_names { ABS_X, ABS_Y, ABS_Z, ABS_RX, ABS_RY, ABS_RZ, ABS_THROTTLE };
-                for (int i = 0; i < abs_names.size(); ++i) {
-                    auto info = libevdev_get_abs_info(device->get_device(), abs_names[i]);
+        // Google Stadia Controller
 
-                    auto range = double(info->maximum - info->minimum);
-                    values[i] = (info->value - info->minimum) / range;
-                    values[i] = (values[i] * 2) - 1;
-                }
+        register_profile<StadiaProfile>(evdev_subsystem, ProfileFlags::Grab | ProfileFlags::HideHid,
+                [](EvInputDevice* device) { return StadiaCurves(device); },
+                [](EvInputDevice* device, EvDevInputDeviceEventType type, const ProfileState<StadiaProfile>& state, StadiaCurves& curves) {
+            if (type == EvDevInputDeviceEventType::DeviceRemoved) {
+                log_debug("Joystick [{}] removed", device->get_name());
+                return;
+            }
 
 #if INPUT_NOISY_JOYSTICKS
-                log_info("Abs: {:5.2f} {:5.2f} {:5.2f} {:5.2f} {:5.2f} {:5.2f} {:5.2f}",
-                    values[0], values[1], values[2], values[3], values[4], values[5], values[6]);
+            std::string output;
+            for (uint32_t i = 0; i < state.AxisCount; ++i) output += std::format(" {:5.2f}", state.axes[i]);
+            log_info("Stadia: {} -- {:#x}", output, state.buttons);
 #endif
 
-                auto throttle = maprange(values[0], -1, 1, -0.1, 1);
-                auto wheel = gamma(values[1], 2.0);
-                auto brake_handbrake = deadzone(values[3], 0.05, 0.120);
-                auto brake = std::max(-brake_handbrake, 0.0);
-                auto handbrake = std::max(brake_handbrake, 0.0) * 2;
-
-                auto rs_forward = values[2] > 0.25;
-                auto rs_back = values[2] < -0.25;
-                auto right_shoulder = values[4] > 0;
+            auto wheel = double(curves.wheel(state.raw_axis<ABS_Z>(), state.raw_axis<ABS_RZ>()));
+            auto left_x = state.raw_axis<ABS_X>();
+            auto left_y = state.raw_axis<ABS_Y>();
+            auto throttle = double(curves.throttle(left_x, left_y));
+            auto brake = double(curves.brake(left_x, left_y));
+            auto handbrake = double(curves.handbrake(left_x, left_y));
+            if (state.button<BTN_TL>()) handbrake = 1.0;
+            brake = std::min(1.0, brake + state.axis<ABS_GAS>());
 
-                joy_report(wheel, throttle, brake, handbrake, rs_forward, rs_back, right_shoulder);
-            });
+            auto a = state.button<BTN_SOUTH>();
+            auto y = state.button<BTN_WEST>();
+            auto right_shoulder = state.button<BTN_TR>();
 
-            return true;
+            joy_report(wheel, throttle, brake, handbrake, a, right_shoulder, y);
         });
+
+        // Taranis X9D, mapped by a pipeline rather than by hand
+
+        static Pipeline taranis(&joy_state);
+        taranis
+            .source(EV_ABS, ABS_X, "throttle")
+            .source(EV_ABS, ABS_Y, "wheel")
+            .source(EV_ABS, ABS_Z, "switch")
+            .source(EV_ABS, ABS_RX, "brake_handbrake")
+            .source(EV_ABS, ABS_RY, "shoulder")
+            .stage(PipelineStageType::MapRange, {"throttle"}, {"throttle"}, {-1, 1, -0.1f, 1})
+            .stage(PipelineStageType::Gamma, {"wheel"}, {"wheel"}, {2.0})
+            .stage(PipelineStageType::Deadzone, {"brake_handbrake"}, {"brake_handbrake"}, {0.05f, 0.120f})
+            .stage(PipelineStageType::MapRange, {"brake_handbrake"}, {"brake"}, {-1, 0, 1, 0, true})
+            .stage(PipelineStageType::MapRange, {"brake_handbrake"}, {"handbrake"}, {0, 1, 0, 2, true})
+            .stage(PipelineStageType::Above, {"switch"}, {"rs_forward"}, {0.25f})
+            .stage(PipelineStageType::Below, {"switch"}, {"rs_back"}, {-0.25f})
+            .stage(PipelineStageType::Above, {"shoulder"}, {"right_shoulder"}, {0})
+            .sink(EV_ABS, ABS_X, "wheel", 32767)
+            .sink(EV_ABS, ABS_Y, "throttle", 32767, -1)
+            .sink(EV_ABS, ABS_Z, "brake", 32767, -1)
+            .sink(EV_ABS, ABS_RX, "handbrake", 32767, -1)
+            .sink(EV_KEY, BTN_TRIGGER, "rs_forward")
+            .sink(EV_KEY, BTN_THUMB, "rs_back")
+            .sink(EV_KEY, BTN_THUMB2, "right_shoulder");
+
+        register_profile_sink<TaranisProfile>(evdev_subsystem, ProfileFlags::Grab | ProfileFlags::HideHid, taranis);
     }
 }
@@ -1,11 +1,16 @@
 #include "example.hpp"
 
+#include "input/uinput_writer.hpp"
+#include "input/key_remapper.hpp"
+
 #include <libevdev/libevdev-uinput.h>
 
 namespace input::example
 {
     static EvInputDevice* keyboard_in;
     static libevdev_uinput* keyboard_uinput = nullptr;
+    static UInputWriter keyboard_writer;
+    static KeyRemapper keyboard_remapper;
 
     static
     void create_virtual_keyboard()
@@ -20,113 +25,54 @@ namespace input::example
 
         log_info("Configuring virtual keyboard");
 
-        for (auto[type, max_code] : {
-            std::pair{EV_KEY, KEY_MAX},
-        }) {
-            for (int code = 0; code <= max_code; ++code) {
-                if (libevdev_has_event_code(keyboard_in->get_device(), type, code)) {
-                    // log_info("  Enabling {}: {}", libevdev_event_type_get_name(type), libevdev_event_code_get_name(type, code));
-                    libevdev_enable_event_code(keyboard_out, type, code, nullptr);
-                }
-            }
-        }
+        keyboard_in->copy_capabilities(keyboard_out, EV_KEY);
 
         unix_check_ne(libevdev_uinput_create_from_device(keyboard_out, LIBEVDEV_UINPUT_OPEN_MANAGED, &keyboard_uinput));
+        keyboard_writer = UInputWriter(keyboard_uinput, event_bus);
     }
 
     static
-    void keyboard_input_callback(EvInputDevice* device, EvDevInputDeviceEventType ev_type, input_event ev)
+    void keyboard_input_callback(EvInputDevice* device, EvDevInputDeviceEventType ev_type, const input_event& ev)
     {
         if (ev_type == EvDevInputDeviceEventType::DeviceRemoved) {
             log_info("Keyboard removed...");
+            keyboard_writer.reset();
             libevdev_uinput_destroy(keyboard_uinput);
             keyboard_in = nullptr;
             keyboard_uinput = nullptr;
             return;
         }
 
-        auto press = [&](int code) {
-            unix_check_ne(libevdev_uinput_write_event(keyboard_uinput, EV_KEY, code, 1));
-            unix_check_ne(libevdev_uinput_write_event(keyboard_uinput, EV_SYN, SYN_REPORT, 0));
-        };
-
-        auto release = [&](int code) {
-            unix_check_ne(libevdev_uinput_write_event(keyboard_uinput, EV_KEY, code, 0));
-            unix_check_ne(libevdev_uinput_write_event(keyboard_uinput, EV_SYN, SYN_REPORT, 0));
-        };
+        // Output is buffered and sent once the input frame (or macro) is complete
 
-        auto type = [&](int code) {
-            press(code);
-            release(code);
-        };
-
-        static bool alt_queued = false;
-        static bool alt_down = false;
-
-        auto special_modifier = KEY_F13;
-        auto special_modifier_output = KEY_LEFTALT;
-
-        if (ev.type == EV_KEY && ev.code == KEY_S && libevdev_get_event_value(keyboard_in->get_device(), EV_KEY, special_modifier) && ev.value > 0) {
-            if (ev.value == 1) {
-                log_trace("Mapping (special_1+S -> \"std::\")");
+        keyboard_remapper.process(ev, keyboard_writer);
+        if (ev.type == EV_SYN) keyboard_writer.flush();
+    }
 
-                type(KEY_S);
-                type(KEY_T);
-                type(KEY_D);
-                press(KEY_LEFTSHIFT);
-                type(KEY_SEMICOLON);
-                type(KEY_SEMICOLON);
-                release(KEY_LEFTSHIFT);
+    static
+    void configure_remapper()
+    {
+        keyboard_remapper = KeyRemapper();
 
-                alt_queued = false;
-            }
-        } else if (ev.type == EV_KEY && ev.code == KEY_W && libevdev_get_event_value(keyboard_in->get_device(), EV_KEY, special_modifier) && ev.value > 0) {
-            if (ev.value == 1) {
-                log_trace("Mapping (special_1+W -> \"->\")");
+        // F13 acts as Alt, and as a layer for programming shortcuts
 
-                type(KEY_MINUS);
-                press(KEY_LEFTSHIFT);
-                type(KEY_DOT);
-                release(KEY_LEFTSHIFT);
+        auto special_1 = keyboard_remapper.add_modifier(KEY_F13, KEY_LEFTALT);
 
-                alt_queued = false;
-            }
-        } else if (ev.type == EV_KEY && ev.code == KEY_D && libevdev_get_event_value(keyboard_in->get_device(), EV_KEY, special_modifier) && ev.value > 0) {
-            if (ev.value == 1) {
-                log_trace("Mapping (special_1+D -> \"::\")");
+        keyboard_remapper.map_macro({ special_1, KEY_S }, KeyMacro()  // "std::"
+            .tap(KEY_S).tap(KEY_T).tap(KEY_D)
+            .press(KEY_LEFTSHIFT).tap(KEY_SEMICOLON).tap(KEY_SEMICOLON).release(KEY_LEFTSHIFT));
 
-                press(KEY_LEFTSHIFT);
-                type(KEY_SEMICOLON);
-                type(KEY_SEMICOLON);
-                release(KEY_LEFTSHIFT);
+        keyboard_remapper.map_macro({ special_1, KEY_W }, KeyMacro()  // "->"
+            .tap(KEY_MINUS)
+            .press(KEY_LEFTSHIFT).tap(KEY_DOT).release(KEY_LEFTSHIFT));
 
-                alt_queued = false;
-            }
-        } else if (ev.type == EV_KEY) {
-            if (ev.code == special_modifier) {
-                if (ev.value) {
-                    alt_queued = true;
-                } else {
-                    release(special_modifier_output);
-                    alt_queued = false;
-                    alt_down = false;
-                }
-            } else {
-                if (alt_queued && !alt_down && ev.value == 1) {
-                    log_trace("Mapping (special_1) -> alt");
-                    press(special_modifier_output);
-                    alt_down = true;
-                }
-                unix_check_ne(libevdev_uinput_write_event(keyboard_uinput, ev.type, ev.code, ev.value));
-            }
-        } else if (ev.type != EV_MSC || ev.type != MSC_SCAN) {
-            unix_check_ne(libevdev_uinput_write_event(keyboard_uinput, ev.type, ev.code, ev.value));
-        }
+        keyboard_remapper.map_macro({ special_1, KEY_D }, KeyMacro()  // "::"
+            .press(KEY_LEFTSHIFT).tap(KEY_SEMICOLON).tap(KEY_SEMICOLON).release(KEY_LEFTSHIFT));
     }
 
     void init_keyboard(int argc, char* argv[])
     {
-        evdev_subsystem->register_device_filter([=](EvInputDevice* device) -> bool {
+        evdev_subsystem->register_device_filter({ .classes = EvDevClass::Keyboard }, [=](EvInputDevice* device) -> bool {
             if (keyboard_in || !device->has_keyboard()) return false;
 
             auto name = device->get_name();
@@ -136,6 +82,7 @@ namespace input::example
                 keyboard_in = device;
                 log_info("  Selected");
                 create_virtual_keyboard();
+                configure_remapper();
                 keyboard_in->grab();
                 evdev_subsystem->register_input_device_event_callback(keyboard_in, keyboard_input_callback);
                 return true;
@@ -1,15 +1,19 @@
 #include "example.hpp"
 
 #include "input/math.hpp"
+#include "input/mouse_motion.hpp"
+#include "input/uinput_writer.hpp"
 
 #include <libevdev/libevdev-uinput.h>
 
 #include <chrono>
+#include <cstdlib>
 
 namespace input::example
 {
     static EvInputDevice* mouse_in;
     static libevdev_uinput* mouse_out_uinput = nullptr;
+    static UInputWriter mouse_out_writer;
 
     static
     void create_virtual_mouse()
@@ -24,27 +28,29 @@ namespace input::example
 
         log_info("Configuring virtual mouse");
 
-        for (auto[type, max_code] : {
-                std::pair{EV_KEY, KEY_MAX},
-                std::pair{EV_REL, REL_MAX},
-                std::pair{EV_ABS, ABS_MAX},
-        }) {
-            for (int code = 0; code <= max_code; ++code) {
-                if (libevdev_has_event_code(mouse_in->get_device(), type, code)) {
-                    log_info("  Enabling {}: {}", libevdev_event_type_get_name(type), libevdev_event_code_get_name(type, code));
-                    libevdev_enable_event_code(mouse_out, type, code, nullptr);
-                }
-            }
+        for (auto type : { EV_KEY, EV_REL, EV_ABS }) {
+            mouse_in->get_capabilities().for_each_code(type, [&](uint32_t code) {
+                log_info("  Enabling {}: {}", libevdev_event_type_get_name(type), libevdev_event_code_get_name(type, code));
+            });
+            mouse_in->copy_capabilities(mouse_out, type);
         }
 
         libevdev_enable_event_code(mouse_out, EV_KEY, KEY_LEFTCTRL, nullptr);
         libevdev_enable_event_code(mouse_out, EV_KEY, KEY_F22, nullptr);
 
         unix_check_ne(libevdev_uinput_create_from_device(mouse_out, LIBEVDEV_UINPUT_OPEN_MANAGED, &mouse_out_uinput));
+        mouse_out_writer = UInputWriter(mouse_out_uinput, event_bus);
     }
 
-    static vec2 delta_in = 0.0;
-    static vec2 delta_out = 0.0;
+    static MouseMotion mouse_motion;
+    static int32_t delta_in_x = 0;
+    static int32_t delta_in_y = 0;
+
+    // Period that accumulated motion is forwarded at, set from INPUT_MOUSE_RATE (reports per second) to match
+    //   the consumer's polling rate, e.g. 1000 to bring an 8kHz mouse down to 1kHz. Zero (the default) forwards
+    //   motion with every input report that moves at least one whole count. Buttons and other events are never
+    //   delayed, pending motion is sent along with them.
+    static std::chrono::nanoseconds mouse_output_period = 0ns;
 
 #define NOISY_EVENTS 0
 #define REPORT_STATS 0
@@ -54,125 +60,100 @@ namespace input::example
     static struct {
         chr::steady_clock::time_point last_report = {};
         chr::steady_clock::duration report_period = 250ms;
-        vec2 max_sens = {};
 
         vec2 moved = {};
         double distance = {};
         double dots_per_meter = 1600.0 / 0.0254;
     } stats;
-#endif
 
-    enum class AccelMode
+    static
+    void report_stats()
     {
-        ComponentWise,
-        Whole,
-    };
+        auto now = chr::steady_clock::now();
+        defer { stats.last_report = now; };
+
+        if (!stats.moved && !stats.distance) return;
+
+        auto delta_s = chr::duration_cast<chr::duration<double>>(now - stats.last_report).count();
+
+        log_info("delta ({:6}, {:6}) remainder ({:5.2f}, {:5.2f}) speed {:.2f} cm/s",
+            stats.moved.x, stats.moved.y,
+            mouse_motion.remainder_x(), mouse_motion.remainder_y(),
+            (stats.distance / delta_s) * (100.0 / stats.dots_per_meter));
+        stats.moved = {};
+        stats.distance = {};
+    }
+#endif
 
     static
-    auto apply_accel(vec2 delta, AccelMode mode) -> vec2
+    void emit_motion()
     {
-        // Apply a linear mouse acceleration curve
-        //
-        // Offset - speed before acceleration is applied
-        // Accel  - rate that sensitivity increases with motion
-        // Mult   - total multplier for sensitivity
-        //
-        //      /
-        //     / <- Accel
-        // ___/
-        //  ^-- Offset
-
-        constexpr auto offset = 2.0;
-        constexpr auto accel = 0.05;
-        constexpr auto sens_mult = 1.0;
-
-        vec2 sens;
-        switch (mode) {
-            break;case AccelMode::ComponentWise:
-                sens = vec2(sens_mult) * (vec2(1) + (max(abs(delta), vec2(offset)) - vec2(offset)) * accel);
-            break;case AccelMode::Whole: {
-                auto speed = sqrt(delta.x * delta.x + delta.y * delta.y);
-                sens = vec2(sens_mult * (1 + (max(speed, offset) - offset) * accel));
-            }
-            break;default:
-                std::unreachable();
-        }
+        int32_t dx, dy;
+        if (!mouse_motion.take(&dx, &dy)) return;
 
 #if REPORT_STATS
-        stats.max_sens = max(stats.max_sens, sens);
+        stats.moved += vec2(dx, dy);
+        stats.distance += mag(vec2(dx, dy));
 #endif
 
-        return sens * delta;
-    };
+        if (dx) mouse_out_writer.emit(EV_REL, REL_X, dx);
+        if (dy) mouse_out_writer.emit(EV_REL, REL_Y, dy);
+    }
 
     static
-    void mouse_input_callback(EvInputDevice* device, EvDevInputDeviceEventType type, input_event ev)
+    void flush_output()
+    {
+        // Reports that produced nothing (sub-count motion, filtered events) don't reach the virtual device
+        if (mouse_out_writer.events.empty()) return;
+
+        mouse_out_writer.sync();
+        mouse_out_writer.flush();
+    }
+
+    static
+    void mouse_input_callback(EvInputDevice* device, EvDevInputDeviceEventType type, std::span<const input_event> frame, const EvDevState& state)
     {
         if (type == EvDevInputDeviceEventType::DeviceRemoved) {
             raise_error("Mouse removed!");
         }
 
-        if      (ev.type == EV_REL && ev.code == REL_X) delta_in.x += ev.value;
-        else if (ev.type == EV_REL && ev.code == REL_Y) delta_in.y += ev.value;
-        else if (ev.type == EV_SYN && ev.code == SYN_REPORT) {
-            // constexpr static auto accel_mode = AccelMode::ComponentWise;
-            constexpr static auto accel_mode = AccelMode::Whole;
-
-            delta_out += apply_accel(delta_in, accel_mode);
-            // delta_out += delta_in;
-            delta_in = {};
-
-            auto i_move_delta = round_to_zero(delta_out);
-            delta_out -= i_move_delta;
-
-#if REPORT_STATS
-            stats.moved += i_move_delta;
-            stats.distance += mag(i_move_delta);
-            if (stats.moved || stats.distance) {
-                auto now = chr::steady_clock::now();
-                if (now > stats.last_report + stats.report_period) {
-                    auto delta_s = chr::duration_cast<chr::duration<double>>(now - stats.last_report).count();
-
-                    log_info("delta ({:6}, {:6}) remainder ({:5.2f}, {:5.2f}) max sense ({}) speed {:.2f} cm/s",
-                        stats.moved.x, stats.moved.y,
-                        delta_out.x, delta_out.y,
-                        accel_mode == AccelMode::ComponentWise
-                            ? std::format("{:4.2f}, {:4.2f}", stats.max_sens.x, stats.max_sens.y)
-                            : std::format("{:4.2f}", stats.max_sens.x),
-                        (stats.distance / delta_s) * (100.0 / stats.dots_per_meter));
-                    stats.last_report = now;
-                    stats.max_sens = {};
-                    stats.moved = {};
-                    stats.distance = {};
+        for (auto& ev : frame) {
+            if      (ev.type == EV_REL && ev.code == REL_X) delta_in_x += ev.value;
+            else if (ev.type == EV_REL && ev.code == REL_Y) delta_in_y += ev.value;
+            else if (ev.type == EV_SYN && ev.code == SYN_REPORT) {
+                mouse_motion.add(delta_in_x, delta_in_y);
+                delta_in_x = delta_in_y = 0;
+
+                if (mouse_output_period == 0ns || !mouse_out_writer.events.empty()) emit_motion();
+                flush_output();
+            } else {
+                if (ev.type == EV_KEY && ev.code == BTN_EXTRA) {
+                    log_trace("Mouse, mapping (BTN_EXTRA -> KEY_LEFTCTRL) = {}", ev.value);
+                    mouse_out_writer.emit(ev.type, KEY_LEFTCTRL, ev.value);
+                } else if (ev.type == EV_KEY && ev.code == BTN_SIDE) {
+                    if (ev.value == 1) {
+                        log_trace("Mouse, mapping (BTN_SIDE -> KEY_F22) = {}", ev.value);
+                        mouse_out_writer.emit(ev.type, KEY_F22, 1);
+                        mouse_out_writer.sync();
+                        mouse_out_writer.emit(ev.type, KEY_F22, 0);
+                        mouse_out_writer.sync();
+                    }
+                } else if (ev.type != EV_MSC || ev.type != MSC_SCAN) {
+                    mouse_out_writer.emit(ev.type, ev.code, ev.value);
                 }
             }
-#endif
-
-            if (i_move_delta.x) unix_check_ne(libevdev_uinput_write_event(mouse_out_uinput, EV_REL, REL_X, int(i_move_delta.x)));
-            if (i_move_delta.y) unix_check_ne(libevdev_uinput_write_event(mouse_out_uinput, EV_REL, REL_Y, int(i_move_delta.y)));
-
-            unix_check_ne(libevdev_uinput_write_event(mouse_out_uinput, EV_SYN, SYN_REPORT, 0));
-        } else {
-            if (ev.type == EV_KEY && ev.code == BTN_EXTRA) {
-                log_trace("Mouse, mapping (BTN_EXTRA -> KEY_LEFTCTRL) = {}", ev.value);
-                unix_check_ne(libevdev_uinput_write_event(mouse_out_uinput, ev.type, KEY_LEFTCTRL, ev.value));
-            } else if (ev.type == EV_KEY && ev.code == BTN_SIDE) {
-                if (ev.value == 1) {
-                    log_trace("Mouse, mapping (BTN_SIDE -> KEY_F22) = {}", ev.value);
-                    unix_check_ne(libevdev_uinput_write_event(mouse_out_uinput, ev.type, KEY_F22, 1));
-                    unix_check_ne(libevdev_uinput_write_event(mouse_out_uinput, EV_SYN, SYN_REPORT, ev.value));
-                    unix_check_ne(libevdev_uinput_write_event(mouse_out_uinput, ev.type, KEY_F22, 0));
-                    unix_check_ne(libevdev_uinput_write_event(mouse_out_uinput, EV_SYN, SYN_REPORT, ev.value));
-                }
-            } else if (ev.type != EV_MSC || ev.type != MSC_SCAN) {
-                unix_check_ne(libevdev_uinput_write_event(mouse_out_uinput, ev.type, ev.code, ev.value));
-            }
         }
     }
 
     void init_mouse(int argc, char* argv[])
     {
-        evdev_subsystem->register_device_filter([=](EvInputDevice* device) -> bool {
+        if (auto rate = getenv("INPUT_MOUSE_RATE")) {
+            auto hz = std::strtoul(rate, nullptr, 10);
+            mouse_output_period = hz ? std::chrono::nanoseconds(1'000'000'000 / hz) : 0ns;
+            log_info("Mouse output rate: {}", hz ? std::format("{} Hz", hz) : "unlimited"s);
+        }
+
+        evdev_subsystem->register_device_filter({ .classes = EvDevClass::Mouse }, [=](EvInputDevice* device) -> bool {
             if (mouse_in || !device->has_mouse()) return false;
 
             auto name = device->get_name();
@@ -181,8 +162,19 @@ namespace input::example
                 mouse_in = device;
                 log_info("  Selected!");
                 create_virtual_mouse();
+                mouse_motion.configure({ .mode = MouseAccelMode::Whole, .offset = 2.0, .accel = 0.05, .mult = 1.0 });
                 mouse_in->grab();
-                evdev_subsystem->register_input_device_event_callback(mouse_in, mouse_input_callback);
+                evdev_subsystem->register_input_device_frame_callback(mouse_in, mouse_input_callback);
+                if (mouse_output_period != 0ns) {
+                    event_bus->schedule_every(mouse_output_period, [] {
+                        emit_motion();
+                        flush_output();
+                    });
+                }
+#if REPORT_STATS
+                stats.last_report = chr::steady_clock::now();
+                event_bus->schedule_every(stats.report_period, report_stats);
+#endif
                 return true;
             }
             return false;
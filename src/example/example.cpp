@@ -1,5 +1,11 @@
 #include "example.hpp"
 
+#include "input/input_recording.hpp"
+
+#include <signal.h>
+#include <sys/signalfd.h>
+#include <unistd.h>
+
 namespace input::example
 {
     FdEventBus* event_bus;
@@ -9,9 +15,27 @@ namespace input::example
     static
     int cmain(int argc, char* argv[])
     {
-        event_bus = FdEventBus::create();
+        event_bus = FdEventBus::create(getenv("INPUT_IO_URING") ? FdEventBusBackend::IoUring : FdEventBusBackend::Epoll);
         defer { unref(event_bus); };
 
+        // Report forwarding latency on SIGUSR1. Blocked before any threads are started so that it is only delivered via the signalfd
+
+        sigset_t report_signals;
+        sigemptyset(&report_signals);
+        sigaddset(&report_signals, SIGUSR1);
+        unix_check_n1(sigprocmask(SIG_BLOCK, &report_signals, nullptr));
+        auto report_fd = unix_check_n1(signalfd(-1, &report_signals, SFD_NONBLOCK | SFD_CLOEXEC));
+        auto report_listener = event_bus->register_fd_listener(report_fd, EPOLLIN, [report_fd](FdEventData) {
+            signalfd_siginfo info;
+            while (read(report_fd, &info, sizeof(info)) == sizeof(info)) {
+                evdev_subsystem->report_latency();
+            }
+        });
+        defer {
+            event_bus->unregister_fd_listener(report_listener);
+            close(report_fd);
+        };
+
         udev_subsystem = UDevSubsystem::create();
         defer { unref(udev_subsystem); };
 
@@ -23,10 +47,23 @@ namespace input::example
         evdev_subsystem = EvDevSubsystem::create(event_bus, udev_subsystem);
         defer { unref(evdev_subsystem); };
 
+        // INPUT_RECORD_DIR captures every selected device, INPUT_REPLAY feeds a capture back in its place
+
+        if (auto dir = getenv("INPUT_RECORD_DIR")) {
+            evdev_subsystem->record_devices(dir);
+        }
+
         init_joystick(argc, argv);
         init_mouse(argc, argv);
         init_keyboard(argc, argv);
 
+        InputReplay* replay = nullptr;
+        defer { unref(replay); };
+        if (auto path = getenv("INPUT_REPLAY")) {
+            replay = InputReplay::create(event_bus, evdev_subsystem, path,
+                getenv("INPUT_REPLAY_FAST") ? InputReplayMode::AsFastAsPossible : InputReplayMode::RealTime);
+        }
+
         udev_subsystem->start(event_bus);
         event_bus->run();
 
@@ -0,0 +1,120 @@
+#pragma once
+
+#include "core.hpp"
+
+#include <experimental/simd>
+
+#include <cstdint>
+#include <limits>
+#include <span>
+
+namespace input
+{
+    // Vectorized conditioning over blocks of axes stored as separate arrays (one value per axis, parameters
+    //   likewise per axis). Every axis in a block is processed together, a lane per axis. Each kernel matches
+    //   its scalar counterpart in math.hpp, see `input-bench --check-kernels`.
+    //
+    //   Block sizes must be a multiple of AxisLanes, see axis_padded(). Padding lanes are processed like any
+    //   other and their results should be ignored.
+
+    namespace stdx = std::experimental;
+
+    using AxisFloats = stdx::native_simd<float>;
+    using AxisInts = stdx::rebind_simd_t<int32_t, AxisFloats>;
+
+    // Padding to the widest native vector we target (AVX-512), so layouts don't depend on build flags
+    constexpr size_t AxisLanes = 16;
+    static_assert(AxisLanes % AxisFloats::size() == 0);
+
+    constexpr size_t axis_padded(size_t count)
+    {
+        return (count + AxisLanes - 1) / AxisLanes * AxisLanes;
+    }
+
+    namespace axis_detail
+    {
+        inline AxisFloats load(const float* data) { return AxisFloats(data, stdx::element_aligned); }
+        inline AxisInts   load(const int32_t* data) { return AxisInts(data, stdx::element_aligned); }
+
+        template<typename T>
+        void check_block(std::span<T> block)
+        {
+            if (block.size() % AxisLanes) [[unlikely]] raise_error("Axis block of {} is not padded to {} lanes", block.size(), AxisLanes);
+        }
+    }
+
+    // out = raw * scale + offset, with scale and offset derived from absinfo
+    inline void axes_normalize(std::span<const int32_t> raw, std::span<const float> scale, std::span<const float> offset, std::span<float> out)
+    {
+        using namespace axis_detail;
+        check_block(out);
+        for (size_t i = 0; i < out.size(); i += AxisFloats::size()) {
+            auto v = stdx::static_simd_cast<AxisFloats>(load(&raw[i])) * load(&scale[i]) + load(&offset[i]);
+            v.copy_to(&out[i], stdx::element_aligned);
+        }
+    }
+
+    // Axial deadzone, as deadzone() in math.hpp
+    inline void axes_deadzone(std::span<float> values, std::span<const float> inner, std::span<const float> outer)
+    {
+        using namespace axis_detail;
+        check_block(values);
+        for (size_t i = 0; i < values.size(); i += AxisFloats::size()) {
+            auto v = load(&values[i]);
+            auto in = load(&inner[i]);
+            auto magnitude = stdx::abs(v);
+            auto span = AxisFloats(1.f) - in - load(&outer[i]);
+            auto out = stdx::copysign(stdx::min((magnitude - in) / span, AxisFloats(1.f)), v);
+            stdx::where(magnitude < in || span <= 0.f, out) = 0.f;
+            out.copy_to(&values[i], stdx::element_aligned);
+        }
+    }
+
+    // Radial deadzone over (x, y) pairs, as deadzone_radial() in math.hpp
+    inline void axes_deadzone_radial(std::span<float> xs, std::span<float> ys, std::span<const float> inner, std::span<const float> outer)
+    {
+        using namespace axis_detail;
+        check_block(xs);
+        for (size_t i = 0; i < xs.size(); i += AxisFloats::size()) {
+            auto x = load(&xs[i]);
+            auto y = load(&ys[i]);
+            auto in = load(&inner[i]);
+            auto r = stdx::sqrt(x * x + y * y);
+            auto span = AxisFloats(1.f) - in - load(&outer[i]);
+            auto d = stdx::min((r - in) / span, AxisFloats(1.f));
+
+            // Bump output by an ulp as the scalar version does, so full deflection doesn't flicker below 1.0
+            d *= 1.f + std::numeric_limits<float>::epsilon();
+
+            auto s = d / r;
+            stdx::where(r <= in || span <= 0.f, s) = 0.f;
+            (x * s).copy_to(&xs[i], stdx::element_aligned);
+            (y * s).copy_to(&ys[i], stdx::element_aligned);
+        }
+    }
+
+    // Sign preserving power curve, as gamma() in math.hpp. A gamma of 1 leaves values unchanged
+    inline void axes_gamma(std::span<float> values, std::span<const float> gamma)
+    {
+        using namespace axis_detail;
+        check_block(values);
+        for (size_t i = 0; i < values.size(); i += AxisFloats::size()) {
+            auto v = load(&values[i]);
+            auto out = stdx::copysign(stdx::pow(stdx::abs(v), load(&gamma[i])), v);
+            out.copy_to(&values[i], stdx::element_aligned);
+        }
+    }
+
+    // Clamps to [-1, 1] and maps linearly onto [low, high], e.g. a uinput axis range
+    inline void axes_rescale(std::span<const float> values, std::span<const float> low, std::span<const float> high, std::span<int32_t> out)
+    {
+        using namespace axis_detail;
+        check_block(out);
+        for (size_t i = 0; i < out.size(); i += AxisFloats::size()) {
+            auto v = stdx::clamp(load(&values[i]), AxisFloats(-1.f), AxisFloats(1.f));
+            auto l = load(&low[i]);
+            auto mapped = l + (v + 1.f) * 0.5f * (load(&high[i]) - l);
+            stdx::static_simd_cast<AxisInts>(stdx::round(mapped)).copy_to(&out[i], stdx::element_aligned);
+        }
+    }
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <initializer_list>
+
+namespace input
+{
+    // Fixed size packed bitset. Unlike std::bitset the storage is exposed, so it can be filled directly
+    //   by ioctls such as EVIOCGBIT (little-endian arrays of unsigned long), and set bits can be visited
+    //   a word at a time.
+
+    template<size_t N>
+    struct BitSet
+    {
+        static constexpr size_t WordBits = 64;
+        static constexpr size_t WordCount = (N + WordBits - 1) / WordBits;
+
+        std::array<uint64_t, WordCount> words = {};
+
+        constexpr BitSet() = default;
+
+        constexpr BitSet(std::initializer_list<uint32_t> bits)
+        {
+            for (auto bit : bits) set(bit);
+        }
+
+        static constexpr size_t size() { return N; }
+
+        constexpr bool test(uint32_t bit) const
+        {
+            return bit < N && (words[bit / WordBits] >> (bit % WordBits)) & 1;
+        }
+
+        constexpr void set(uint32_t bit, bool value = true)
+        {
+            auto mask = uint64_t(1) << (bit % WordBits);
+            if (value) words[bit / WordBits] |= mask;
+            else       words[bit / WordBits] &= ~mask;
+        }
+
+        constexpr void reset()
+        {
+            words = {};
+        }
+
+        constexpr uint32_t count() const
+        {
+            uint32_t total = 0;
+            for (auto word : words) total += std::popcount(word);
+            return total;
+        }
+
+        constexpr bool any() const
+        {
+            for (auto word : words) if (word) return true;
+            return false;
+        }
+
+        constexpr bool intersects(const BitSet& other) const
+        {
+            for (size_t i = 0; i < WordCount; ++i) if (words[i] & other.words[i]) return true;
+            return false;
+        }
+
+        // Lowest set bit, or N if none are set
+        constexpr uint32_t first() const
+        {
+            for (size_t i = 0; i < WordCount; ++i) {
+                if (words[i]) return uint32_t(i * WordBits + std::countr_zero(words[i]));
+            }
+            return N;
+        }
+
+        // Calls fn(bit) for each set bit, in ascending order
+        template<typename Fn>
+        constexpr void for_each(Fn&& fn) const
+        {
+            for (size_t i = 0; i < WordCount; ++i) {
+                for (auto word = words[i]; word; word &= word - 1) {
+                    fn(uint32_t(i * WordBits + std::countr_zero(word)));
+                }
+            }
+        }
+
+        friend constexpr BitSet operator&(BitSet l, const BitSet& r) { for (size_t i = 0; i < WordCount; ++i) l.words[i] &= r.words[i]; return l; }
+        friend constexpr BitSet operator|(BitSet l, const BitSet& r) { for (size_t i = 0; i < WordCount; ++i) l.words[i] |= r.words[i]; return l; }
+        friend constexpr BitSet operator^(BitSet l, const BitSet& r) { for (size_t i = 0; i < WordCount; ++i) l.words[i] ^= r.words[i]; return l; }
+
+        friend constexpr bool operator==(const BitSet&, const BitSet&) = default;
+    };
+}
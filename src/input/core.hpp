@@ -6,6 +6,8 @@
 #include <stdexcept>
 #include <print>
 
+#include "log.hpp"
+
 using namespace std::literals;
 
 #include <string.h>
@@ -32,35 +34,17 @@ namespace input
 
 #define text_ansi_color(color, text) "\u001B[" #color "m" text "\u001B[0m"
 
-    template<typename ...Args>
-    void log_trace(std::format_string<Args...> fmt, Args&&... args)
-    {
-        std::println("[" text_ansi_color(90, "TRACE") "] " text_ansi_color(90, "{}"), std::vformat(fmt.get(), std::make_format_args(args...)));
-    }
-
-    template<typename ...Args>
-    void log_debug(std::format_string<Args...> fmt, Args&&... args)
-    {
-        std::println("[" text_ansi_color(96, "DEBUG") "] {}", std::vformat(fmt.get(), std::make_format_args(args...)));
-    }
-
-    template<typename ...Args>
-    void log_info(std::format_string<Args...> fmt, Args&&... args)
-    {
-        std::println(" [" text_ansi_color(94, "INFO") "] {}", std::vformat(fmt.get(), std::make_format_args(args...)));
-    }
+// Macros so that calls below INPUT_LOG_LEVEL don't evaluate their arguments. Discarded calls are still
+//   compiled, so their format strings keep being checked
 
-    template<typename ...Args>
-    void log_warn(std::format_string<Args...> fmt, Args&&... args)
-    {
-        std::println(" [" text_ansi_color(93, "WARN") "] {}", std::vformat(fmt.get(), std::make_format_args(args...)));
-    }
+#define log_at_level(level, ...) \
+    do { if constexpr (::input::LogLevel::level >= ::input::CompiledLogLevel) ::input::log_write<::input::LogLevel::level>(__VA_ARGS__); } while (0)
 
-    template<typename ...Args>
-    void log_error(std::format_string<Args...> fmt, Args&&... args)
-    {
-        std::println("[" text_ansi_color(91, "ERROR") "] {}", std::vformat(fmt.get(), std::make_format_args(args...)));
-    }
+#define log_trace(...) log_at_level(Trace, __VA_ARGS__)
+#define log_debug(...) log_at_level(Debug, __VA_ARGS__)
+#define log_info(...)  log_at_level(Info,  __VA_ARGS__)
+#define log_warn(...)  log_at_level(Warn,  __VA_ARGS__)
+#define log_error(...) log_at_level(Error, __VA_ARGS__)
 
 // -----------------------------------------------------------------------------
 
@@ -70,6 +54,7 @@ namespace input
     {
         auto message = std::vformat(fmt.get(), std::make_format_args(args...));
         log_error("{}", message);
+        log_flush();
         throw std::runtime_error(message);
     }
 
@@ -0,0 +1,268 @@
+#pragma once
+
+#include "evdev_subsystem.hpp"
+#include "axis_kernels.hpp"
+
+#include <array>
+#include <memory>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+namespace input
+{
+    // Compile-time description of a specific controller. A profile is a type with static members:
+    //
+    //   struct MyPad
+    //   {
+    //       static constexpr std::string_view name = "My Pad";
+    //       static constexpr uint16_t vendor = 0x1234, product = 0x5678;
+    //       static constexpr std::array axes { ProfileAxis{ABS_X}, ProfileAxis{ABS_GAS, 0, 1} };
+    //       static constexpr std::array buttons { BTN_SOUTH, BTN_EAST };
+    //   };
+    //
+    //   register_profile<MyPad>(evdev, ProfileFlags::Grab, [](EvInputDevice*, EvDevInputDeviceEventType, const ProfileState<MyPad>& state) {
+    //       state.axis<ABS_GAS>(); state.button<BTN_SOUTH>();
+    //   });
+    //
+    //   Per device data (e.g. response curves built from the device's absinfo) can be created when a device
+    //   is matched, and is handed to the callback alongside the state until the device is removed:
+    //
+    //   register_profile<MyPad>(evdev, ProfileFlags::Grab, [](EvInputDevice* device) { return MyCurves(device); },
+    //       [](EvInputDevice*, EvDevInputDeviceEventType, const ProfileState<MyPad>& state, MyCurves& curves) { ... });
+    //
+    // Each axis and button gets a fixed slot, so decoding a frame is a table lookup per event with no searching,
+    //   plus one vectorized normalization of all axes. Unlisted codes land in a discard slot rather than being
+    //   branched around.
+
+    struct ProfileAxis
+    {
+        uint16_t code;
+
+        // Output range the axis minimum and maximum map to
+        float low = -1.f;
+        float high = 1.f;
+    };
+
+    template<typename P>
+    concept DeviceProfile = requires {
+        { P::name } -> std::convertible_to<std::string_view>;
+        { P::vendor } -> std::convertible_to<uint16_t>;
+        { P::product } -> std::convertible_to<uint16_t>;
+        P::axes.size();
+        P::buttons.size();
+    };
+
+    enum class ProfileFlags : uint32_t
+    {
+        None = 0,
+        Grab = 1 << 0,    // Grab the device on match
+        HideHid = 1 << 1, // Hide the parent HID device (and its other interfaces) from other consumers
+    };
+
+    constexpr ProfileFlags operator|(ProfileFlags l, ProfileFlags r) { return ProfileFlags(uint32_t(l) | uint32_t(r)); }
+    constexpr bool operator&(ProfileFlags l, ProfileFlags r) { return uint32_t(l) & uint32_t(r); }
+
+    template<DeviceProfile P>
+    struct ProfileState
+    {
+        static constexpr size_t AxisCount = P::axes.size();
+        static constexpr size_t ButtonCount = P::buttons.size();
+        static_assert(ButtonCount < 64, "Buttons are packed into a single word, with one bit for discards");
+
+        // One extra trailing slot absorbs events for codes not in the profile, padded out for axis_kernels
+        static constexpr size_t AxisSlotCount = axis_padded(AxisCount + 1);
+        std::array<float, AxisSlotCount> axes = {};
+        std::array<int32_t, AxisSlotCount> raw = {}; // Unnormalized values, e.g. for ResponseCurve lookups
+        uint64_t buttons = 0;
+
+        static constexpr uint32_t axis_slot(uint16_t code)
+        {
+            for (uint32_t i = 0; i < AxisCount; ++i) if (P::axes[i].code == code) return i;
+            return AxisCount;
+        }
+
+        static constexpr uint32_t button_slot(uint16_t code)
+        {
+            for (uint32_t i = 0; i < ButtonCount; ++i) if (P::buttons[i] == code) return i;
+            return ButtonCount;
+        }
+
+        template<uint16_t Code>
+        float axis() const
+        {
+            constexpr auto slot = axis_slot(Code);
+            static_assert(slot < AxisCount, "Axis not in profile");
+            return axes[slot];
+        }
+
+        template<uint16_t Code>
+        int32_t raw_axis() const
+        {
+            constexpr auto slot = axis_slot(Code);
+            static_assert(slot < AxisCount, "Axis not in profile");
+            return raw[slot];
+        }
+
+        template<uint16_t Code>
+        bool button() const
+        {
+            constexpr auto slot = button_slot(Code);
+            static_assert(slot < ButtonCount, "Button not in profile");
+            return (buttons >> slot) & 1;
+        }
+    };
+
+    template<DeviceProfile P>
+    struct ProfileDecoder
+    {
+        using State = ProfileState<P>;
+
+        // Code to slot, built at compile time
+        static constexpr auto AxisSlots = [] {
+            std::array<uint8_t, ABS_CNT> slots;
+            for (uint32_t code = 0; code < ABS_CNT; ++code) slots[code] = uint8_t(State::axis_slot(code));
+            return slots;
+        }();
+
+        static constexpr auto AxisMask = [] {
+            BitSet<ABS_CNT> mask;
+            for (auto& axis : P::axes) mask.set(axis.code);
+            return mask;
+        }();
+
+        static constexpr auto ButtonSlots = [] {
+            std::array<uint8_t, KEY_CNT> slots;
+            for (uint32_t code = 0; code < KEY_CNT; ++code) slots[code] = uint8_t(State::button_slot(code));
+            return slots;
+        }();
+
+        // Maps raw values straight to the profile's output range, derived from the device's absinfo
+        std::array<float, State::AxisSlotCount> scale = {};
+        std::array<float, State::AxisSlotCount> offset = {};
+
+        State state;
+
+        explicit ProfileDecoder(EvInputDevice* device)
+        {
+            auto evdev = device->get_device();
+            for (uint32_t i = 0; i < State::AxisCount; ++i) {
+                auto& axis = P::axes[i];
+                auto info = libevdev_get_abs_info(evdev, axis.code);
+                if (!info) continue;
+                auto range = double(info->maximum - info->minimum);
+                auto s = range ? (axis.high - axis.low) / range : 0.0;
+                scale[i] = float(s);
+                offset[i] = float(axis.low - info->minimum * s);
+                state.raw[i] = info->value;
+            }
+            axes_normalize(state.raw, scale, offset, state.axes);
+
+            auto& keys = device->get_pressed_keys();
+            for (uint32_t i = 0; i < State::ButtonCount; ++i) {
+                state.buttons |= uint64_t(keys.test(P::buttons[i])) << i;
+            }
+        }
+
+        // Raw values are gathered into their slots, then every axis is normalized at once
+        void decode(std::span<const input_event> frame)
+        {
+            bool abs_changed = false;
+
+            for (auto& ev : frame) {
+                switch (ev.type) {
+                    break;case EV_ABS:
+                        state.raw[AxisSlots[ev.code & (ABS_CNT - 1)]] = ev.value;
+                        abs_changed = true;
+                    break;case EV_KEY: {
+                        auto slot = ev.code < KEY_CNT ? ButtonSlots[ev.code] : State::ButtonCount;
+                        state.buttons = (state.buttons & ~(uint64_t(1) << slot)) | (uint64_t(ev.value != 0) << slot);
+                    }
+                }
+            }
+
+            if (abs_changed) axes_normalize(state.raw, scale, offset, state.axes);
+        }
+    };
+
+    namespace profile_detail
+    {
+        // Accepts nodes that report every profile axis, hiding and grabbing them as requested
+        template<DeviceProfile P>
+        bool claim(EvInputDevice* device, ProfileFlags flags)
+        {
+            constexpr auto& axis_mask = ProfileDecoder<P>::AxisMask;
+            if ((device->get_capabilities().abs & axis_mask) != axis_mask) return false;
+            log_info("Found [{}]: {}", P::name, device->get_name());
+
+            // Synthetic and replayed devices have no udev node
+            if (flags & ProfileFlags::HideHid) {
+                if (auto node = device->get_udev_node()) node->parent->hide();
+            }
+            if (flags & ProfileFlags::Grab) device->grab();
+
+            return true;
+        }
+
+        template<DeviceProfile P, typename Context>
+        struct DeviceState
+        {
+            ProfileDecoder<P> decoder;
+            Context context;
+        };
+
+        struct NoContext {};
+    }
+
+    // Registers a filter matching the profile's VID/PID (checked before nodes are opened) on nodes that report
+    //   every profile axis (other interfaces of the same device, e.g. consumer control, are skipped). Matched
+    //   devices are decoded into a ProfileState which is handed to the callback once per frame.
+    //
+    //   With make_context, make_context(device) is called on match and its result is passed to every callback
+    //   for that device as a mutable reference.
+    template<DeviceProfile P, typename ContextFn, typename Fn>
+    void register_profile(EvDevSubsystem* evdev, ProfileFlags flags, ContextFn&& make_context, Fn&& callback)
+    {
+        using Context = std::invoke_result_t<ContextFn&, EvInputDevice*>;
+        using DeviceState = profile_detail::DeviceState<P, Context>;
+
+        EvDevMatch match { .vendor = P::vendor, .product = P::product };
+        evdev->register_device_filter(std::move(match), [=, make_context = std::forward<ContextFn>(make_context), callback = std::forward<Fn>(callback)]
+                (EvInputDevice* device) -> bool {
+            if (!profile_detail::claim<P>(device, flags)) return false;
+
+            // Decoder state is too large to store inline in the callback
+            auto device_state = std::unique_ptr<DeviceState>(new DeviceState { ProfileDecoder<P>(device), make_context(device) });
+            evdev->register_input_device_frame_callback(device, [device_state = std::move(device_state), callback]
+                    (EvInputDevice* device, EvDevInputDeviceEventType type, std::span<const input_event> frame, const EvDevState&) {
+                auto& decoder = device_state->decoder;
+                if (type != EvDevInputDeviceEventType::DeviceRemoved) decoder.decode(frame);
+                callback(device, type, std::as_const(decoder.state), device_state->context);
+            });
+
+            return true;
+        });
+    }
+
+    template<DeviceProfile P, typename Fn>
+    void register_profile(EvDevSubsystem* evdev, ProfileFlags flags, Fn&& callback)
+    {
+        register_profile<P>(evdev, flags, [](EvInputDevice*) { return profile_detail::NoContext(); },
+                [callback = std::forward<Fn>(callback)](EvInputDevice* device, EvDevInputDeviceEventType type, const ProfileState<P>& state, profile_detail::NoContext&) {
+            callback(device, type, state);
+        });
+    }
+
+    // As register_profile, but matched devices feed a frame sink (e.g. a Pipeline) directly, without decoding.
+    //   The sink must outlive the subsystem.
+    template<DeviceProfile P, typename Sink>
+    void register_profile_sink(EvDevSubsystem* evdev, ProfileFlags flags, Sink& sink)
+    {
+        EvDevMatch match { .vendor = P::vendor, .product = P::product };
+        evdev->register_device_filter(std::move(match), [=, &sink](EvInputDevice* device) -> bool {
+            if (!profile_detail::claim<P>(device, flags)) return false;
+            evdev->register_input_device_frame_sink(device, sink);
+            return true;
+        });
+    }
+}
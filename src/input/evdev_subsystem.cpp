@@ -1,35 +1,121 @@
 #include "evdev_subsystem.hpp"
 
+#include "spsc_queue.hpp"
+#include "input_recording.hpp"
+#include "axis_kernels.hpp"
+
 #include <memory>
 #include <thread>
+#include <array>
+#include <mutex>
+#include <unordered_map>
 
 #include <libevdev/libevdev.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <sys/stat.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
 
 namespace input
 {
+    struct EvDevReaderThread;
+
     struct EvDevSubsystem::Impl : EvDevSubsystem
     {
         FdEventBus* event_bus;
         std::vector<std::unique_ptr<EvInputDevice::Impl>> devices;
-        std::vector<EvDevDeviceFilter> device_filters;
+
+        struct DeviceFilter
+        {
+            EvDevMatch match;
+            EvDevDeviceFilter filter;
+        };
+        std::vector<DeviceFilter> device_filters;
+
+        // Indices into device_filters, see EvDevMatch
+        struct FilterIndex
+        {
+            std::unordered_map<uint32_t, std::vector<uint32_t>> by_id; // vendor << 16 | product
+            std::unordered_map<std::string, std::vector<uint32_t>> by_name;
+            std::array<std::vector<uint32_t>, EvDevClassCount> by_class;
+            std::vector<uint32_t> unindexed;
+        };
+        FilterIndex filter_index;
+
+        std::string record_directory;
+        uint32_t recording_count = 0;
+
+        // Declared after devices so that readers are stopped before any device is freed
+        std::vector<std::unique_ptr<EvDevReaderThread>> readers;
     };
 
     struct EvInputDevice::Impl : EvInputDevice
     {
         std::string devnode;
+        EvDevMetadata metadata;
         libevdev* device = nullptr;
         UDevHidNode* node = nullptr;
         int fd = -1;
+        FdListenerHandle listener;
+
+        EvDevCapabilities caps;
+
+        // Maintained incrementally from events, so grab readiness and state queries never need a scan
+        EvDevState state;
+
+        // Per axis normalization, state.abs = abs_raw * scale + offset. Raw values are collected while applying
+        //   a frame and normalized together at the end of it
+        std::array<int32_t, ABS_CNT> abs_raw = {};
+        std::array<float, ABS_CNT> abs_scale = {};
+        std::array<float, ABS_CNT> abs_offset = {};
 
         bool needs_sync = false;
+        // Seen by a resync ioctl. Removed once the current read has been handled, or by the reader thread's
+        //   next read failing the same way
+        bool disconnected = false;
+
+        // Fed from a stand-in fd (e.g. a pipe) instead of an evdev node, state is tracked by libevdev only
+        bool synthetic = false;
 
         bool wants_grab = false;
         bool grabbed = false;
 
+        // Raw events are read in bulk into this buffer and split into frames at SYN_REPORT.
+        //   Any trailing partial frame is moved back to the front after dispatch.
+        std::array<input_event, 256> read_buffer;
+        uint32_t read_count = 0;
+
+        // Pipes (synthetic devices) may split an event across reads. Its leading bytes are kept here until
+        //   the rest arrives, one copy for the bus thread and one for the reader thread.
+        input_event partial_event;
+        uint32_t partial_size = 0;
+        input_event reader_partial_event;
+        uint32_t reader_partial_size = 0;
+
+        std::vector<input_event> sync_frame;
+
+        // Clock used for kernel event timestamps
+        clockid_t clock = CLOCK_REALTIME;
+
+        LatencyHistogram latency;
+        EvDevStats stats;
+
+        std::unique_ptr<InputRecorder> recorder;
+
+        // Threaded reading, see EvDevReaderThread. Events read ahead on the reader thread that predate
+        //   a resync snapshot are stale and discarded on hand-off.
+        EvDevReaderThread* reader = nullptr;
+        std::unique_ptr<SpscQueue<input_event>> queue;
+        std::atomic<bool> reader_stalled = false;
+        std::atomic<bool> reader_closed = false;
+        std::atomic<bool> reader_detached = false; // Detach request acknowledged, implies `reader_closed`
+        bool detaching = false;
+        std::optional<timeval> discard_before;
+
         std::vector<EvDevInputDeviceEventCallback> event_callbacks;
+        std::vector<EvDevInputDeviceFrameCallback> frame_callbacks;
+        std::vector<std::pair<void*, EvDevInputDeviceFrameSinkFn>> frame_sinks;
 
         ~Impl()
         {
@@ -41,13 +127,14 @@ namespace input
 
     void try_grab(EvInputDevice::Impl* self, bool force = false)
     {
-        if (!force) {
-            for (int code = 0; code <= KEY_MAX; ++code) {
-                if (libevdev_get_event_value(self->device, EV_KEY, code)) {
-                    log_warn("Can't grab [{}], {} pressed", libevdev_get_name(self->device), libevdev_event_code_get_name(EV_KEY, code));
-                    return;
-                }
-            }
+        if (self->synthetic) {
+            self->wants_grab = false;
+            return;
+        }
+
+        if (!force && self->state.held_count) {
+            log_warn("Can't grab [{}], {} pressed", libevdev_get_name(self->device), libevdev_event_code_get_name(EV_KEY, self->state.keys.first()));
+            return;
         }
 
         unix_check_ne(libevdev_grab(self->device, LIBEVDEV_GRAB));
@@ -87,15 +174,22 @@ namespace input
     int         EvInputDevice::get_vid()      { return libevdev_get_id_vendor( get_impl(this)->device); }
     int         EvInputDevice::get_pid()      { return libevdev_get_id_product(get_impl(this)->device); }
 
-    bool        EvInputDevice::has_gamepad()  { return libevdev_has_event_code(get_impl(this)->device, EV_KEY, BTN_GAMEPAD);  }
-    bool        EvInputDevice::has_joystick() { return libevdev_has_event_code(get_impl(this)->device, EV_KEY, BTN_JOYSTICK); }
-    bool        EvInputDevice::has_mouse()    { return libevdev_has_event_code(get_impl(this)->device, EV_KEY, BTN_MOUSE);    }
-    bool        EvInputDevice::has_keyboard() { return libevdev_has_event_code(get_impl(this)->device, EV_KEY, KEY_ENTER);    }
+    bool        EvInputDevice::has_gamepad()  { return get_impl(this)->caps.key.test(BTN_GAMEPAD);  }
+    bool        EvInputDevice::has_joystick() { return get_impl(this)->caps.key.test(BTN_JOYSTICK); }
+    bool        EvInputDevice::has_mouse()    { return get_impl(this)->caps.key.test(BTN_MOUSE);    }
+    bool        EvInputDevice::has_keyboard() { return get_impl(this)->caps.key.test(KEY_ENTER);    }
+    const LatencyHistogram& EvInputDevice::get_latency() { return get_impl(this)->latency; }
+    const EvDevStats& EvInputDevice::get_stats() { return get_impl(this)->stats; }
+    const EvDevCapabilities& EvInputDevice::get_capabilities() { return get_impl(this)->caps; }
+    const EvDevState& EvInputDevice::get_state() { return get_impl(this)->state; }
+    const BitSet<KEY_CNT>& EvInputDevice::get_pressed_keys() { return get_impl(this)->state.keys; }
+    uint32_t    EvInputDevice::get_held_count() { return get_impl(this)->state.held_count; }
+
     bool        EvInputDevice::has_cctrl()
     {
         decl_self(this);
 
-        static constexpr int ConsumerControlKeys[] {
+        static constexpr BitSet<KEY_CNT> ConsumerControlKeys {
             KEY_MUTE,
             KEY_VOLUMEDOWN,
             KEY_VOLUMEUP,
@@ -119,68 +213,814 @@ namespace input
             KEY_SEARCH,
         };
 
-        static constexpr int ConsumerControlAbs[] {
+        static constexpr BitSet<ABS_CNT> ConsumerControlAbs {
             ABS_VOLUME,
         };
 
-        for (auto key : ConsumerControlKeys) if (libevdev_has_event_code(self->device, EV_KEY, key)) return true;
-        for (auto abs : ConsumerControlAbs)  if (libevdev_has_event_code(self->device, EV_ABS, abs)) return true;
-        return false;
+        return self->caps.key.intersects(ConsumerControlKeys)
+            || self->caps.abs.intersects(ConsumerControlAbs);
+    }
+
+    void EvInputDevice::copy_capabilities(libevdev* target, uint32_t type)
+    {
+        decl_self(this);
+
+        self->caps.for_each_code(type, [&](uint32_t code) {
+            libevdev_enable_event_code(target, type, code, type == EV_ABS ? libevdev_get_abs_info(self->device, code) : nullptr);
+        });
     }
 
     namespace
     {
-        void handle_evdev_input_event(EvDevSubsystem::Impl* self, EvInputDevice::Impl* device)
-        {
-            input_event ev = {};
+        // Captures capabilities with one EVIOCGBIT per type, rather than one libevdev query per code
 
-            for (;;) {
-                auto res = unix_check_ne(libevdev_next_event(device->device,
-                    device->needs_sync ? LIBEVDEV_READ_FLAG_SYNC : LIBEVDEV_READ_FLAG_NORMAL, &ev), EAGAIN, ENODEV);
+        void load_capabilities(EvInputDevice::Impl* device)
+        {
+            auto& caps = device->caps;
 
-                if (res == LIBEVDEV_READ_STATUS_SYNC) {
-                    device->needs_sync = true;
-                    if (ev.type == EV_SYN && ev.code == SYN_DROPPED) {
-                        log_debug("Sync required");
-                        continue;
-                    } else {
-                        log_debug("Sync ({}) = {}", libevdev_event_code_get_name(ev.type, ev.code), ev.value);
+            if (device->synthetic) {
+                // No evdev node to query, libevdev holds the only description of the device
+                auto load = [&](uint32_t type, auto& bits) {
+                    for (uint32_t code = 0; code < bits.size(); ++code) {
+                        if (libevdev_has_event_code(device->device, type, code)) bits.set(code);
                     }
+                };
+                for (uint32_t type = 0; type < EV_CNT; ++type) {
+                    if (libevdev_has_event_type(device->device, type)) caps.types.set(type);
+                }
+                load(EV_KEY, caps.key);
+                load(EV_REL, caps.rel);
+                load(EV_ABS, caps.abs);
+                load(EV_MSC, caps.msc);
+                return;
+            }
+
+            auto load = [&](uint32_t type, auto& bits) {
+                unix_check_n1(ioctl(device->fd, EVIOCGBIT(type, sizeof(bits.words)), bits.words.data()));
+            };
+            load(0, caps.types);
+            load(EV_KEY, caps.key);
+            load(EV_REL, caps.rel);
+            load(EV_ABS, caps.abs);
+            load(EV_MSC, caps.msc);
+        }
+
+        void load_state(EvInputDevice::Impl* device)
+        {
+            auto& state = device->state;
+
+            if (device->synthetic) {
+                device->caps.key.for_each([&](uint32_t code) {
+                    if (libevdev_get_event_value(device->device, EV_KEY, code)) state.keys.set(code);
+                });
+            } else {
+                unix_check_n1(ioctl(device->fd, EVIOCGKEY(sizeof(state.keys.words)), state.keys.words.data()));
+            }
+            state.held_count = state.keys.count();
+
+            device->caps.abs.for_each([&](uint32_t code) {
+                auto info = libevdev_get_abs_info(device->device, code);
+                auto range = double(info->maximum - info->minimum);
+                auto scale = range ? 2.0 / range : 0.0;
+                device->abs_scale[code] = float(scale);
+                device->abs_offset[code] = float(-1.0 - info->minimum * scale);
+                device->abs_raw[code] = info->value;
+            });
+            axes_normalize(device->abs_raw, device->abs_scale, device->abs_offset, state.abs);
+        }
+
+        void apply_to_state(EvInputDevice::Impl* device, const input_event& ev)
+        {
+            auto& state = device->state;
+
+            switch (ev.type) {
+                break;case EV_KEY: {
+                    if (ev.code >= KEY_CNT) return;
+                    bool down = ev.value != 0;
+                    if (state.keys.test(ev.code) == down) return;
+                    state.keys.set(ev.code, down);
+                    state.keys_changed.set(ev.code);
+                    if (down) state.held_count++;
+                    else      state.held_count--;
                 }
-                else if (res == -EAGAIN) {
+                break;case EV_ABS:
+                    if (ev.code >= ABS_CNT) return;
+                    device->abs_raw[ev.code] = ev.value;
+                    state.abs_changed.set(ev.code);
+                break;case EV_REL:
+                    if (ev.code >= REL_CNT) return;
+                    state.rel[ev.code] += ev.value;
+                    state.rel_changed.set(ev.code);
+            }
+        }
+
+        void begin_state_frame(EvInputDevice::Impl* device)
+        {
+            auto& state = device->state;
+            state.rel_changed.for_each([&](uint32_t code) { state.rel[code] = 0; });
+            state.rel_changed.reset();
+            state.abs_changed.reset();
+            state.keys_changed.reset();
+        }
+
+        void notify_device_removed(EvInputDevice::Impl* device)
+        {
+            for (auto& cb : device->event_callbacks) {
+                cb(device, EvDevInputDeviceEventType::DeviceRemoved, {});
+            }
+            static const EvDevState empty_state;
+            for (auto& cb : device->frame_callbacks) {
+                cb(device, EvDevInputDeviceEventType::DeviceRemoved, {}, empty_state);
+            }
+            for (auto[sink, fn] : device->frame_sinks) {
+                fn(sink, device, EvDevInputDeviceEventType::DeviceRemoved, {}, empty_state);
+            }
+        }
+
+        void dispatch_frame(EvInputDevice::Impl* device, std::span<const input_event> frame, EvDevInputDeviceEventType type = EvDevInputDeviceEventType::InputEvent)
+        {
+            // Synthesized resync frames carry no meaningful timestamp
+            bool measure = type == EvDevInputDeviceEventType::InputEvent && device->clock == CLOCK_MONOTONIC;
+            if (measure) latency_begin_frame(&device->latency, frame.back().time);
+            defer { latency_end_frame(); };
+
+            if (device->recorder) device->recorder->record(frame);
+
+            begin_state_frame(device);
+            bool key_released = false;
+
+            for (auto& ev : frame) {
+#define NOISY_EVDEV_EVENTS 0
+#if     NOISY_EVDEV_EVENTS
+                if (ev.type != EV_REL && ev.type != EV_SYN) {
+                    log_trace("Event ({}) = {}", libevdev_event_code_get_name(ev.type, ev.code), ev.value);
+                }
+#endif
+                // Keep libevdev's view of the device current, so state queries still work for consumers
+
+                switch (ev.type) {
+                    break;case EV_KEY:
+                          case EV_ABS:
+                          case EV_LED:
+                          case EV_SW:
+                        libevdev_set_event_value(device->device, ev.type, ev.code, ev.value);
+                }
+
+                apply_to_state(device, ev);
+                key_released |= ev.type == EV_KEY && !ev.value;
+
+                for (auto& cb : device->event_callbacks) {
+                    cb(device, type, ev);
+                }
+            }
+
+            if (device->state.abs_changed.any()) {
+                axes_normalize(device->abs_raw, device->abs_scale, device->abs_offset, device->state.abs);
+            }
+
+            if (device->wants_grab && key_released && !device->state.held_count /* we'lll only ever be able to successfully grab after a key release */) {
+                try_grab(device);
+            }
+
+            for (auto& cb : device->frame_callbacks) {
+                cb(device, type, frame, device->state);
+            }
+            for (auto[sink, fn] : device->frame_sinks) {
+                fn(sink, device, type, frame, device->state);
+            }
+        }
+
+        // Returns false if the state could not be queried (e.g. the device was unplugged), nothing is dispatched
+
+        bool resync_device(EvInputDevice::Impl* device, const timespec& now)
+        {
+            // Query current state with one ioctl per state type (and per axis), then dispatch only the
+            //   differences from what we last saw as a single frame
+
+            auto start = std::chrono::steady_clock::now();
+            auto time = timeval { .tv_sec = now.tv_sec, .tv_usec = now.tv_nsec / 1000 };
+
+            auto& frame = device->sync_frame;
+            frame.clear();
+            auto push = [&](uint16_t type, uint32_t code, int32_t value) {
+                frame.emplace_back(input_event { .time = time, .type = type, .code = uint16_t(code), .value = value });
+            };
+
+            // Overflows are common while a device is being unplugged, so failures are not fatal
+            bool ok = true;
+            auto query = [&](unsigned long request, void* data) {
+                if (!ok) return false;
+                if (ioctl(device->fd, request, data) != -1) return true;
+                ok = false;
+                if (errno == ENODEV) {
+                    device->disconnected = true;
+                } else {
+                    log_warn("Failed to resync [{}]: ({}) {}", device->get_name(), errno, strerror(errno));
+                }
+                return false;
+            };
+
+            BitSet<KEY_CNT> keys;
+            if (!query(EVIOCGKEY(sizeof(keys.words)), keys.words.data())) return false;
+            (keys ^ device->state.keys).for_each([&](uint32_t code) {
+                push(EV_KEY, code, keys.test(code));
+            });
+
+            device->caps.abs.for_each([&](uint32_t code) {
+                // Multitouch slots would need EVIOCGMTSLOTS, EVIOCGABS only reports the active slot
+                if (code >= ABS_MT_SLOT) return;
+                input_absinfo info;
+                if (!query(EVIOCGABS(code), &info)) return;
+                if (info.value != libevdev_get_event_value(device->device, EV_ABS, code)) push(EV_ABS, code, info.value);
+            });
+
+            auto sync_bits = [&]<size_t N>(uint16_t type, BitSet<N> bits, unsigned long request) {
+                if (!device->caps.types.test(type) || !query(request, bits.words.data())) return;
+                for (uint32_t code = 0; code < N; ++code) {
+                    if (!libevdev_has_event_code(device->device, type, code)) continue;
+                    if (bits.test(code) != bool(libevdev_get_event_value(device->device, type, code))) push(type, code, bits.test(code));
+                }
+            };
+            sync_bits(EV_LED, BitSet<LED_CNT>{}, EVIOCGLED(sizeof(BitSet<LED_CNT>::words)));
+            sync_bits(EV_SW,  BitSet<SW_CNT>{},  EVIOCGSW(sizeof(BitSet<SW_CNT>::words)));
+            if (!ok) return false;
+
+            auto changes = uint32_t(frame.size());
+            push(EV_SYN, SYN_REPORT, 0);
+
+            dispatch_frame(device, frame, EvDevInputDeviceEventType::StateResynced);
+
+            auto duration = uint64_t(std::chrono::nanoseconds(std::chrono::steady_clock::now() - start).count());
+            auto& stats = device->stats;
+            stats.resyncs++;
+            stats.resync_events += changes;
+            stats.resync_ns_total += duration;
+            stats.resync_ns_max = std::max(stats.resync_ns_max, duration);
+
+            log_debug("Resynced [{}], {} changes in {:.1f}us", device->get_name(), changes, double(duration) / 1000.0);
+            return true;
+        }
+
+        void remove_device(EvDevSubsystem::Impl* self, EvInputDevice::Impl* device)
+        {
+            if (device->listener) self->event_bus->unregister_fd_listener(device->listener);
+            self->devices.erase(std::ranges::find(self->devices, device, [](auto& ptr) { return ptr.get(); }));
+            log_debug("Erased device");
+        }
+
+        void resync_and_discard(EvInputDevice::Impl* device)
+        {
+            timespec now;
+            clock_gettime(device->clock, &now);
+
+            device->needs_sync = false;
+            if (device->synthetic) {
+                log_warn("Synthetic device [{}] overflowed, discarding buffered input", device->get_name());
+            } else if (!resync_device(device, now) && !device->disconnected) {
+                // State is still stale, retry at the next SYN_REPORT rather than dispatching against it
+                device->needs_sync = true;
+            }
+
+            // The resync snapshot supersedes anything already buffered
+
+            device->read_count = 0;
+            device->partial_size = 0;
+            if (device->reader) {
+                device->discard_before = timeval { .tv_sec = now.tv_sec, .tv_usec = now.tv_nsec / 1000 };
+            }
+        }
+
+        // Splits newly buffered events (starting from `first`) into frames and dispatches them.
+        //   Returns false if the device was resynced, in which case any further pending input is stale.
+
+        bool process_read_buffer(EvInputDevice::Impl* device, uint32_t first)
+        {
+            auto& buffer = device->read_buffer;
+
+            uint32_t frame_start = 0;
+            for (uint32_t i = first; i < device->read_count; ++i) {
+                auto& ev = buffer[i];
+                if (ev.type != EV_SYN) continue;
+
+                if (ev.code == SYN_DROPPED) {
+                    // Kernel buffer overflowed, everything up to and including the next SYN_REPORT is unreliable
+                    device->needs_sync = true;
+                    device->stats.drops++;
+                } else if (ev.code == SYN_REPORT) {
                     if (device->needs_sync) {
-                        log_debug("Sync completed!");
-                        device->needs_sync = false;
+                        resync_and_discard(device);
+                        return false;
                     }
+
+                    dispatch_frame(device, std::span(buffer.data() + frame_start, i + 1 - frame_start));
+                    frame_start = i + 1;
+                }
+            }
+
+            // Retain trailing partial frame
+
+            device->read_count -= frame_start;
+            if (device->read_count && frame_start) {
+                std::memmove(buffer.data(), buffer.data() + frame_start, device->read_count * sizeof(input_event));
+            }
+
+            return true;
+        }
+
+        void flush_oversized_frame(EvInputDevice::Impl* device)
+        {
+            if (device->read_count < device->read_buffer.size()) return;
+
+            log_warn("Frame from [{}] exceeds read buffer, dispatching partial frame", device->get_name());
+            dispatch_frame(device, std::span(device->read_buffer.data(), device->read_count));
+            device->read_count = 0;
+        }
+
+        // Free space at the end of the read buffer, so reads can land in place. A partially read event is put
+        //   back in front, so that the rest of it lands right after
+        std::span<std::byte> read_buffer_space(EvInputDevice::Impl* device)
+        {
+            flush_oversized_frame(device);
+            auto space = std::as_writable_bytes(std::span(device->read_buffer).subspan(device->read_count));
+            std::memcpy(space.data(), &device->partial_event, device->partial_size);
+            return space.subspan(device->partial_size);
+        }
+
+        // Keeps the bytes of a trailing partial event, returning the whole events before it
+        std::span<const std::byte> split_partial_event(EvInputDevice::Impl* device, std::span<const std::byte> data)
+        {
+            auto whole = data.size() / sizeof(input_event) * sizeof(input_event);
+            device->partial_size = uint32_t(data.size() - whole);
+            std::memcpy(&device->partial_event, data.data() + whole, device->partial_size);
+            return data.first(whole);
+        }
+
+        void ingest_events(EvInputDevice::Impl* device, std::span<const std::byte> data)
+        {
+            // Read straight into the buffer by the bus, after any partial event, only the count needs updating
+            auto in_place = reinterpret_cast<const std::byte*>(device->read_buffer.data() + device->read_count);
+            if (data.data() == in_place + device->partial_size) {
+                auto events = split_partial_event(device, std::span(in_place, device->partial_size + data.size()));
+                auto first = device->read_count;
+                device->read_count += uint32_t(events.size() / sizeof(input_event));
+                process_read_buffer(device, first);
+                return;
+            }
+
+            if (device->partial_size) {
+                auto n = std::min(data.size(), sizeof(input_event) - device->partial_size);
+                std::memcpy(reinterpret_cast<std::byte*>(&device->partial_event) + device->partial_size, data.data(), n);
+                device->partial_size += uint32_t(n);
+                data = data.subspan(n);
+                if (device->partial_size < sizeof(input_event)) return;
+
+                // Completed, it goes ahead of the rest
+                auto completed = device->partial_event;
+                device->partial_size = 0;
+                flush_oversized_frame(device);
+                device->read_buffer[device->read_count++] = completed;
+                if (!process_read_buffer(device, device->read_count - 1)) return;
+            }
+
+            data = split_partial_event(device, data);
+            auto count = uint32_t(data.size() / sizeof(input_event));
+            while (count) {
+                flush_oversized_frame(device);
+
+                auto n = std::min<uint32_t>(count, uint32_t(device->read_buffer.size() - device->read_count));
+                std::memcpy(device->read_buffer.data() + device->read_count, data.data(), n * sizeof(input_event));
+                data = data.subspan(n * sizeof(input_event));
+                count -= n;
+
+                auto first = device->read_count;
+                device->read_count += n;
+                if (!process_read_buffer(device, first)) return;
+            }
+        }
+
+        void handle_evdev_read(EvDevSubsystem::Impl* self, EvInputDevice::Impl* device, const FdReadData& read)
+        {
+            if (read.error) {
+                if (read.error != ENODEV) raise_unix_error("read", read.error);
+            } else if (!read.data.empty()) {
+                ingest_events(device, read.data);
+                if (!device->disconnected) return;
+            }
+
+            log_debug("Device [{}] disconnected", device->get_name());
+            notify_device_removed(device);
+            remove_device(self, device);
+        }
+    }
+
+// -----------------------------------------------------------------------------
+
+    // Reader threads own a private epoll set containing a shard of device fds. Raw events are read straight
+    //   into a per-device SPSC queue and the bus thread is woken through an eventfd to split and dispatch
+    //   frames, so a slow device or a slow callback never delays reads from other devices. Per-device event
+    //   order is preserved as each device is only ever read by a single thread.
+
+    struct EvDevReaderThread
+    {
+        EvDevSubsystem::Impl* subsystem;
+
+        int epollfd = -1;
+        int wakefd = -1;   // bus thread -> reader
+        int notifyfd = -1; // reader -> bus thread
+        FdListenerHandle notify_listener;
+
+        std::atomic<bool> stop = false;
+
+        // Devices to be removed from the reader, acknowledged by setting `reader_detached`
+        std::mutex mutex;
+        std::vector<EvInputDevice::Impl*> detach_requests;
+
+        // Owned by the bus thread
+        std::vector<EvInputDevice::Impl*> devices;
+
+        std::jthread thread;
+
+        ~EvDevReaderThread()
+        {
+            if (thread.joinable()) {
+                stop = true;
+                eventfd_write(wakefd, 1);
+                thread.join();
+            }
+            if (notify_listener) subsystem->event_bus->unregister_fd_listener(notify_listener);
+            close(notifyfd);
+            close(wakefd);
+            close(epollfd);
+        }
+    };
+
+    namespace
+    {
+        // Reader thread
+
+        void reader_close_device(EvDevReaderThread* reader, EvInputDevice::Impl* device)
+        {
+            // Only the reader sets this, so it can't change under us
+            if (device->reader_closed.load(std::memory_order_relaxed)) return;
+
+            epoll_ctl(reader->epollfd, EPOLL_CTL_DEL, device->fd, nullptr);
+
+            // Device may be freed by the bus thread at any point after this, unless a detach request is pending
+            device->reader_closed.store(true, std::memory_order_release);
+        }
+
+        void reader_detach_device(EvDevReaderThread* reader, EvInputDevice::Impl* device)
+        {
+            // The device may already have been closed after an error, the bus thread holds on to it until this
+            //   acknowledgement either way
+            reader_close_device(reader, device);
+            device->reader_detached.store(true, std::memory_order_release);
+        }
+
+        void reader_read_device(EvDevReaderThread* reader, EvInputDevice::Impl* device)
+        {
+            for (;;) {
+                auto space = device->queue->prepare_write();
+                if (space.empty()) {
+                    // Queue full, stop polling until the bus thread catches up. If this persists the kernel
+                    //   buffer will overflow and the device will be resynced. The fd is removed rather than
+                    //   masked, as EPOLLHUP/EPOLLERR can't be masked and would spin on an unplugged device.
+                    epoll_ctl(reader->epollfd, EPOLL_CTL_DEL, device->fd, nullptr);
+                    device->reader_stalled.store(true, std::memory_order_release);
                     return;
                 }
-                else if (res == -ENODEV) {
-                    log_debug("Device [{}] disconnected", device->get_name());
-                    for (auto& cb : device->event_callbacks) {
-                        cb(device, EvDevInputDeviceEventType::DeviceRemoved, {});
-                    }
-                    self->event_bus->unregister_fd_listener(device->fd);
-                    self->devices.erase(std::ranges::find(self->devices, device, [](auto& ptr) { return ptr.get(); }));
-                    log_debug("Erased device");
+
+                // A partial event left by the last read goes back in front, for the rest of it to land after
+                auto bytes = std::as_writable_bytes(space);
+                auto partial = device->reader_partial_size;
+                std::memcpy(bytes.data(), &device->reader_partial_event, partial);
+
+                auto res = read(device->fd, bytes.data() + partial, bytes.size() - partial);
+                if (res == -1) {
+                    if (errno == EINTR) continue;
+                    if (errno != EAGAIN) reader_close_device(reader, device);
                     return;
                 }
-#define NOISY_EVDEV_EVENTS 0
-#if     NOISY_EVDEV_EVENTS
-                else {
-                    if (ev.type != EV_REL && ev.type != EV_SYN) {
-                        log_trace("Event ({}) = {}", libevdev_event_code_get_name(ev.type, ev.code), ev.value);
+                if (res == 0) {
+                    // End of file, only seen with synthetic devices
+                    reader_close_device(reader, device);
+                    return;
+                }
+
+                auto size = partial + size_t(res);
+                auto count = uint32_t(size / sizeof(input_event));
+                device->reader_partial_size = uint32_t(size % sizeof(input_event));
+                std::memcpy(&device->reader_partial_event, bytes.data() + count * sizeof(input_event), device->reader_partial_size);
+                if (count) device->queue->commit_write(count);
+
+                // Short read, the kernel buffer has been drained
+                if (size < bytes.size()) return;
+            }
+        }
+
+        void reader_run(EvDevReaderThread* reader)
+        {
+            for (;;) {
+                epoll_event events[16];
+                auto events_ready = epoll_wait(reader->epollfd, events, std::size(events), -1);
+                if (events_ready <= 0) continue;
+
+                bool woken = false;
+                for (int i = 0; i < events_ready; ++i) {
+                    if (auto device = static_cast<EvInputDevice::Impl*>(events[i].data.ptr)) {
+                        reader_read_device(reader, device);
+                    } else {
+                        eventfd_t value;
+                        eventfd_read(reader->wakefd, &value);
+                        woken = true;
                     }
                 }
-#endif
 
-                if (device->wants_grab && !ev.value /* we'lll only ever be able to successfully grab after a key release */) {
-                    try_grab(device);
+                // Handle detach requests only after the batch, as later events may reference detached devices
+
+                if (woken) {
+                    if (reader->stop) return;
+
+                    std::scoped_lock lock{reader->mutex};
+                    for (auto* device : reader->detach_requests) reader_detach_device(reader, device);
+                    reader->detach_requests.clear();
                 }
 
-                for (auto& cb : device->event_callbacks) {
-                    cb(device, EvDevInputDeviceEventType::InputEvent, ev);
+                eventfd_write(reader->notifyfd, 1);
+            }
+        }
+
+        // Bus thread
+
+        void drain_reader_queue(EvInputDevice::Impl* device)
+        {
+            auto& queue = *device->queue;
+
+            for (;;) {
+                auto events = queue.prepare_read();
+                if (events.empty()) return;
+
+                if (device->detaching) {
+                    queue.commit_read(uint32_t(events.size()));
+                    continue;
+                }
+
+                defer { queue.commit_read(uint32_t(events.size())); };
+
+                if (device->discard_before) {
+                    auto fresh = std::ranges::find_if(events, [&](const input_event& ev) {
+                        return !timercmp(&ev.time, &*device->discard_before, <);
+                    });
+                    if (fresh == events.end()) continue;
+                    device->discard_before = std::nullopt;
+                    ingest_events(device, std::as_bytes(std::span(fresh, events.end())));
+                    continue;
+                }
+
+                ingest_events(device, std::as_bytes(events));
+            }
+        }
+
+        void handle_reader_notify(EvDevSubsystem::Impl* self, EvDevReaderThread* reader)
+        {
+            eventfd_t value;
+            eventfd_read(reader->notifyfd, &value);
+
+            for (uint32_t i = 0; i < reader->devices.size();) {
+                auto device = reader->devices[i];
+
+                // Observe closure before draining, so that everything pushed before closing is processed. Detaching
+                //   devices wait for the reader to acknowledge the request, even if it closed them on its own first
+                auto closed = device->detaching
+                    ? device->reader_detached.load(std::memory_order_acquire)
+                    : device->reader_closed.load(std::memory_order_acquire);
+
+                drain_reader_queue(device);
+
+                if (closed) {
+                    reader->devices.erase(reader->devices.begin() + i);
+                    if (!device->detaching) {
+                        log_debug("Device [{}] disconnected", device->get_name());
+                        notify_device_removed(device);
+                    }
+                    remove_device(self, device);
+                    continue;
+                }
+
+                // A detaching device may be closed by the reader at any moment, it stays out of the poll set
+                if (!device->detaching && device->reader_stalled.exchange(false, std::memory_order_acquire)) {
+                    epoll_event event { .events = EPOLLIN, .data{.ptr = device} };
+                    unix_check_n1(epoll_ctl(reader->epollfd, EPOLL_CTL_ADD, device->fd, &event));
+                }
+
+                ++i;
+            }
+        }
+
+        void start_reader_thread(EvDevSubsystem::Impl* self)
+        {
+            auto& reader = self->readers.emplace_back(new EvDevReaderThread);
+            reader->subsystem = self;
+            reader->epollfd = unix_check_n1(epoll_create1(EPOLL_CLOEXEC));
+            reader->wakefd = unix_check_n1(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC));
+            reader->notifyfd = unix_check_n1(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC));
+
+            epoll_event event { .events = EPOLLIN, .data{.ptr = nullptr} };
+            unix_check_n1(epoll_ctl(reader->epollfd, EPOLL_CTL_ADD, reader->wakefd, &event));
+
+            reader->notify_listener = self->event_bus->register_fd_listener(reader->notifyfd, EPOLLIN, [self, reader = reader.get()](FdEventData) {
+                handle_reader_notify(self, reader);
+            });
+
+            reader->thread = std::jthread([reader = reader.get()] {
+                reader_run(reader);
+            });
+        }
+
+        void attach_to_reader(EvDevSubsystem::Impl* self, EvInputDevice::Impl* device)
+        {
+            auto reader = std::ranges::min_element(self->readers, {}, [](auto& r) { return r->devices.size(); })->get();
+
+            device->reader = reader;
+            device->queue = std::make_unique<SpscQueue<input_event>>(4096);
+            reader->devices.emplace_back(device);
+
+            epoll_event event { .events = EPOLLIN, .data{.ptr = device} };
+            unix_check_n1(epoll_ctl(reader->epollfd, EPOLL_CTL_ADD, device->fd, &event));
+        }
+
+        void detach_from_reader(EvInputDevice::Impl* device)
+        {
+            // Device is freed once the reader acknowledges, see handle_reader_notify
+
+            device->detaching = true;
+            {
+                std::scoped_lock lock{device->reader->mutex};
+                device->reader->detach_requests.emplace_back(device);
+            }
+            eventfd_write(device->reader->wakefd, 1);
+        }
+
+        void start_recording(EvDevSubsystem::Impl* self, EvInputDevice::Impl* device)
+        {
+            auto path = std::format("{}/{:04x}-{:04x}-{}-{}.inrec", self->record_directory,
+                device->get_vid(), device->get_pid(), time(nullptr), self->recording_count++);
+            auto fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+            if (fd == -1) {
+                log_error("Failed to create recording {}: {}", path, strerror(errno));
+                return;
+            }
+
+            log_info("Recording [{}] to {}", device->get_name(), path);
+            device->recorder = std::make_unique<InputRecorder>(fd, device->device);
+        }
+
+        EvInputDevice::Impl* listen_to_device(EvDevSubsystem::Impl* self, std::unique_ptr<EvInputDevice::Impl> evdev)
+        {
+            log_debug("Listening to device [{}] (fd = {})", evdev->get_name(), evdev->fd);
+            if (!self->record_directory.empty() && !evdev->synthetic) {
+                start_recording(self, evdev.get());
+            }
+            if (self->readers.empty()) {
+                evdev->listener = self->event_bus->register_fd_reader(evdev->fd, [self, evdev = evdev.get()](FdReadData data) {
+                    handle_evdev_read(self, evdev, data);
+                }, [evdev = evdev.get()] {
+                    return read_buffer_space(evdev);
+                });
+            } else {
+                attach_to_reader(self, evdev.get());
+            }
+            return self->devices.emplace_back(std::move(evdev)).get();
+        }
+
+        struct EvDevProbe : UDevProbeResult
+        {
+            std::unique_ptr<EvInputDevice::Impl> device;
+        };
+
+        EvDevMetadata read_metadata(udev_device* dev)
+        {
+            EvDevMetadata metadata;
+
+            auto add_class = [&](const char* property, EvDevClass c) {
+                auto value = udev_device_get_property_value(dev, property);
+                if (value && "1"sv == value) metadata.classes = metadata.classes | c;
+            };
+            add_class("ID_INPUT_MOUSE",    EvDevClass::Mouse);
+            add_class("ID_INPUT_KEYBOARD", EvDevClass::Keyboard);
+            add_class("ID_INPUT_KEY",      EvDevClass::Key);
+            add_class("ID_INPUT_JOYSTICK", EvDevClass::Joystick);
+            add_class("ID_INPUT_TOUCHPAD", EvDevClass::Touchpad);
+            add_class("ID_INPUT_TABLET",   EvDevClass::Tablet);
+
+            // Same identity the kernel reports through EVIOCGID/EVIOCGNAME, so it also covers non-USB devices
+            if (auto input = udev_device_get_parent_with_subsystem_devtype(dev, "input", nullptr)) {
+                metadata.vendor = uint16_t(strtol(udev_device_get_sysattr_value(input, "id/vendor") ?: "", nullptr, 16));
+                metadata.product = uint16_t(strtol(udev_device_get_sysattr_value(input, "id/product") ?: "", nullptr, 16));
+                metadata.name = udev_device_get_sysattr_value(input, "name") ?: "";
+            }
+
+            return metadata;
+        }
+
+        EvDevMetadata synthesize_metadata(EvInputDevice::Impl* device)
+        {
+            EvDevMetadata metadata {
+                .vendor = uint16_t(libevdev_get_id_vendor(device->device)),
+                .product = uint16_t(libevdev_get_id_product(device->device)),
+                .name = libevdev_get_name(device->device) ?: "",
+            };
+
+            if (device->has_mouse()) metadata.classes = metadata.classes | EvDevClass::Mouse;
+            if (device->has_keyboard()) metadata.classes = metadata.classes | EvDevClass::Keyboard;
+            if (device->caps.key.any()) metadata.classes = metadata.classes | EvDevClass::Key;
+            if (device->has_joystick() || device->has_gamepad()) metadata.classes = metadata.classes | EvDevClass::Joystick;
+
+            return metadata;
+        }
+
+        // Indices of the filters whose match accepts the device, in registration order
+
+        std::vector<uint32_t> find_matching_filters(EvDevSubsystem::Impl* self, const EvDevMetadata& metadata)
+        {
+            auto& index = self->filter_index;
+
+            std::vector<uint32_t> matching;
+            auto visit = [&](const std::vector<uint32_t>& bucket) {
+                for (auto i : bucket) {
+                    if (self->device_filters[i].match.matches(metadata)) matching.emplace_back(i);
                 }
+            };
+
+            if (auto bucket = index.by_id.find(uint32_t(metadata.vendor) << 16 | metadata.product); bucket != index.by_id.end()) {
+                visit(bucket->second);
+            }
+            if (auto bucket = index.by_name.find(metadata.name); bucket != index.by_name.end()) {
+                visit(bucket->second);
             }
+            for (uint32_t c = 0; c < EvDevClassCount; ++c) {
+                if (metadata.classes & EvDevClass(1 << c)) visit(index.by_class[c]);
+            }
+            visit(index.unindexed);
+
+            // Filters matching on several classes appear in multiple buckets
+            std::ranges::sort(matching);
+            matching.erase(std::ranges::unique(matching).begin(), matching.end());
+
+            return matching;
+        }
+
+        // Opens and queries an input node if any filter could accept it. Only reads filters, so it is safe to run
+        //   on udev's probe workers
+
+        std::unique_ptr<EvInputDevice::Impl> open_device(EvDevSubsystem::Impl* self, udev_device* dev)
+        {
+            if ("input"sv != udev_device_get_subsystem(dev)) return nullptr;
+
+            auto devnode = udev_device_get_devnode(dev);
+            if (!devnode) return nullptr;
+
+            // Legacy mouseN/jsN interfaces aren't evdev nodes
+            if (!std::string_view(udev_device_get_sysname(dev)).starts_with("event")) return nullptr;
+
+            auto metadata = read_metadata(dev);
+            if (find_matching_filters(self, metadata).empty()) {
+                log_trace("Skipping [{}] ({:#06x}:{:#06x}), no matching filters", metadata.name, metadata.vendor, metadata.product);
+                return nullptr;
+            }
+
+            auto evdev = std::make_unique<EvInputDevice::Impl>();
+            evdev->devnode = devnode;
+            evdev->metadata = std::move(metadata);
+
+            evdev->fd = open(devnode, O_RDONLY | O_NONBLOCK);
+            if (evdev->fd == -1) return nullptr;
+
+            if (unix_check_ne(libevdev_new_from_fd(evdev->fd, &evdev->device), ENOTTY, EINVAL) < 0)
+                return nullptr;
+
+            load_capabilities(evdev.get());
+            load_state(evdev.get());
+
+            // Timestamp events with the same clock used to measure output latency
+            if (libevdev_set_clock_id(evdev->device, CLOCK_MONOTONIC) == 0) {
+                evdev->clock = CLOCK_MONOTONIC;
+            }
+
+            // Detect device type
+
+            if (!(evdev->has_mouse() || evdev->has_keyboard() || evdev->has_gamepad() || evdev->has_joystick() || evdev->has_cctrl())) {
+                return nullptr;
+            }
+
+            return evdev;
+        }
+
+        std::unique_ptr<UDevProbeResult> probe_device(EvDevSubsystem::Impl* self, udev_device* dev)
+        {
+            auto probe = std::make_unique<EvDevProbe>();
+            probe->device = open_device(self, dev);
+            return probe;
         }
 
         void handle_udev_event(EvDevSubsystem::Impl* self, const UDeviceEvent& event)
@@ -191,41 +1031,32 @@ namespace input
                     auto& evdev = *iter;
                     if (evdev->node == event.node) {
                         log_warn("EVDEV DEVICE FORCEFULLY REMOVED VIA UDEV EVENT");
-                        for (auto& cb : evdev->event_callbacks) {
-                            cb(evdev.get(), EvDevInputDeviceEventType::DeviceRemoved, {});
+                        if (evdev->detaching) break;
+                        notify_device_removed(evdev.get());
+                        if (evdev->reader) {
+                            detach_from_reader(evdev.get());
+                        } else {
+                            remove_device(self, evdev.get());
                         }
-                        evdev.reset();
-                        self->devices.erase(iter);
                         break;
                     }
                 }
                 return;
             }
-            if ("input"sv != udev_device_get_subsystem(event.node->dev)) return;
 
-            auto devnode = udev_device_get_devnode(event.node->dev);
-            if (!devnode) return;
+            // Normally opened ahead of time by probe_device
+            auto probe = static_cast<EvDevProbe*>(event.probe);
+            auto evdev = probe ? std::move(probe->device) : open_device(self, event.node->dev);
+            if (!evdev) return;
 
-            auto evdev = std::make_unique<EvInputDevice::Impl>();
-            evdev->devnode = devnode;
             evdev->node = event.node;
 
-            evdev->fd = open(devnode, O_RDONLY | O_NONBLOCK);
-            if (evdev->fd == -1) return;
-
-            if (unix_check_ne(libevdev_new_from_fd(evdev->fd, &evdev->device), ENOTTY, EINVAL) < 0)
-                return;
-
-            // Detect device type
-
             auto has_gamepad  = evdev->has_gamepad();
             auto has_joystick = evdev->has_joystick();
             auto has_mouse    = evdev->has_mouse();
             auto has_keyboard = evdev->has_keyboard();
             auto has_cctrl = evdev->has_cctrl();
 
-            if (!(has_mouse || has_keyboard || has_gamepad || has_joystick || has_cctrl)) return;
-
 #define DUMP_EVDEV_INFO 1
 #define DUMP_EVDEV_CODES 0
 
@@ -245,54 +1076,52 @@ namespace input
 
             log_debug("  codes");
 
-            auto count_codes = [&](int type, int code_min, int code_max) {
-                uint32_t count = 0;
+            auto count_codes = [&](int type) {
+                auto count = evdev->caps.count(type);
+                if (!count) return;
 #if DUMP_EVDEV_CODES
-                for (int code = code_min; code <= code_max; ++code) {
-                    if (libevdev_has_event_code(evdev->device, type, code)) {
-                        if (!count++) log_trace("    BEGIN {}", libevdev_event_type_get_name(type));
-                        log_trace("      {}", libevdev_event_code_get_name(type, code));
-                    }
-                }
-                if (count) log_trace("    END {} (count = {})", libevdev_event_type_get_name(type), count);
+                log_trace("    BEGIN {}", libevdev_event_type_get_name(type));
+                evdev->caps.for_each_code(type, [&](uint32_t code) {
+                    log_trace("      {}", libevdev_event_code_get_name(type, code));
+                });
+                log_trace("    END {} (count = {})", libevdev_event_type_get_name(type), count);
 #else
-            for (int code = code_min; code <= code_max; ++code) {
-                if (libevdev_has_event_code(evdev->device, type, code)) count++;
-            }
-            if (count) log_debug("    {} - {}", libevdev_event_type_get_name(type), count);
+                log_debug("    {} - {}", libevdev_event_type_get_name(type), count);
 #endif
             };
 
-            count_codes(EV_ABS, ABS_X, ABS_MAX);
-            count_codes(EV_REL, REL_X, REL_MAX);
-            count_codes(EV_KEY, KEY_RESERVED, KEY_MAX);
+            count_codes(EV_ABS);
+            count_codes(EV_REL);
+            count_codes(EV_KEY);
 #endif
 
             bool add_device = false;
-            for (auto& filter : self->device_filters) {
-                add_device |= filter(evdev.get());
+            for (auto i : find_matching_filters(self, evdev->metadata)) {
+                add_device |= self->device_filters[i].filter(evdev.get());
             }
 
             if (add_device) {
-                log_debug("Listening to device [{}] (fd = {})", evdev->get_name(), evdev->fd);
-                self->event_bus->register_fd_listener(evdev->fd, EPOLLIN, [self, evdev = evdev.get()](FdEventData data) {
-                    handle_evdev_input_event(self, evdev);
-                });
-                self->devices.emplace_back(std::move(evdev));
+                listen_to_device(self, std::move(evdev));
             }
         }
     }
 
-    EvDevSubsystem* EvDevSubsystem::create(FdEventBus* bus, UDevSubsystem* udev)
+    EvDevSubsystem* EvDevSubsystem::create(FdEventBus* bus, UDevSubsystem* udev, uint32_t reader_threads)
     {
         auto self = new EvDevSubsystem::Impl;
         defer { unref(self); };
 
         self->event_bus = bus;
 
+        for (uint32_t i = 0; i < reader_threads; ++i) {
+            start_reader_thread(self);
+        }
+
         udev->watch_subsystem("input");
         udev->register_device_listener([self](UDeviceEvent event) {
             handle_udev_event(self, event);
+        }, [self](udev_device* dev) {
+            return probe_device(self, dev);
         });
 
         return take(self);
@@ -305,11 +1134,95 @@ namespace input
 
     void EvDevSubsystem::register_device_filter(EvDevDeviceFilter&& callback)
     {
-        get_impl(this)->device_filters.emplace_back(std::move(callback));
+        register_device_filter({}, std::move(callback));
+    }
+
+    void EvDevSubsystem::register_device_filter(EvDevMatch match, EvDevDeviceFilter&& callback)
+    {
+        decl_self(this);
+
+        auto id = uint32_t(self->device_filters.size());
+        auto& index = self->filter_index;
+
+        if (match.vendor && match.product) {
+            index.by_id[uint32_t(*match.vendor) << 16 | *match.product].emplace_back(id);
+        } else if (!match.name.empty()) {
+            index.by_name[match.name].emplace_back(id);
+        } else if (match.classes != EvDevClass::None) {
+            for (uint32_t c = 0; c < EvDevClassCount; ++c) {
+                if (match.classes & EvDevClass(1 << c)) index.by_class[c].emplace_back(id);
+            }
+        } else {
+            index.unindexed.emplace_back(id);
+        }
+
+        self->device_filters.emplace_back(std::move(match), std::move(callback));
     }
 
     void EvDevSubsystem::register_input_device_event_callback(EvInputDevice* device, EvDevInputDeviceEventCallback&& callback)
     {
         get_impl(device)->event_callbacks.emplace_back(std::move(callback));
     }
+
+    EvInputDevice* EvDevSubsystem::add_synthetic_device(int fd, libevdev* device)
+    {
+        decl_self(this);
+
+        auto evdev = std::make_unique<EvInputDevice::Impl>();
+        evdev->devnode = std::format("synthetic:{}", fd);
+        evdev->device = device;
+        evdev->fd = fd;
+        evdev->synthetic = true;
+
+        // Synthetic sources are expected to stamp events with CLOCK_MONOTONIC
+        evdev->clock = CLOCK_MONOTONIC;
+
+        load_capabilities(evdev.get());
+        load_state(evdev.get());
+        evdev->metadata = synthesize_metadata(evdev.get());
+
+        for (auto i : find_matching_filters(self, evdev->metadata)) {
+            self->device_filters[i].filter(evdev.get());
+        }
+
+        return listen_to_device(self, std::move(evdev));
+    }
+
+    void EvDevSubsystem::record_devices(std::string_view directory)
+    {
+        get_impl(this)->record_directory = directory;
+    }
+
+    void EvDevSubsystem::report_latency()
+    {
+        decl_self(this);
+
+        auto us = [](uint64_t ns) { return double(ns) / 1000.0; };
+
+        for (auto& device : self->devices) {
+            auto& latency = device->latency;
+            if (latency.total) {
+                log_info("Latency [{}] frames = {} p50 = {:.1f}us p99 = {:.1f}us p99.9 = {:.1f}us max = {:.1f}us",
+                    device->get_name(), latency.total,
+                    us(latency.percentile(50)), us(latency.percentile(99)), us(latency.percentile(99.9)), us(latency.max));
+            }
+
+            auto& stats = device->stats;
+            if (stats.drops) {
+                log_info("Drops [{}] dropped = {} resyncs = {} changes = {} mean = {:.1f}us max = {:.1f}us",
+                    device->get_name(), stats.drops, stats.resyncs, stats.resync_events,
+                    stats.resyncs ? us(stats.resync_ns_total) / stats.resyncs : 0.0, us(stats.resync_ns_max));
+            }
+        }
+    }
+
+    void EvDevSubsystem::register_input_device_frame_callback(EvInputDevice* device, EvDevInputDeviceFrameCallback&& callback)
+    {
+        get_impl(device)->frame_callbacks.emplace_back(std::move(callback));
+    }
+
+    void EvDevSubsystem::register_input_device_frame_sink(EvInputDevice* device, void* sink, EvDevInputDeviceFrameSinkFn fn)
+    {
+        get_impl(device)->frame_sinks.emplace_back(sink, fn);
+    }
 }
@@ -1,9 +1,14 @@
 #pragma once
 
 #include "udev_subsystem.hpp"
+#include "latency_histogram.hpp"
+#include "bitset.hpp"
 
 #include <libevdev/libevdev.h>
 
+#include <optional>
+#include <span>
+
 namespace input
 {
     struct EvInputDevice;
@@ -12,10 +17,146 @@ namespace input
     {
         InputEvent,
         DeviceRemoved,
+
+        // The kernel dropped events. The frame holds the differences between the last dispatched state and
+        //   the device's current state, queried directly from the device.
+        StateResynced,
+    };
+
+    // Device classes assigned by udev's input_id builtin (ID_INPUT_* properties)
+    enum class EvDevClass : uint32_t
+    {
+        None     = 0,
+        Mouse    = 1 << 0,
+        Keyboard = 1 << 1,
+        Key      = 1 << 2, // Has any keys, e.g. consumer control or power buttons
+        Joystick = 1 << 3, // Includes gamepads
+        Touchpad = 1 << 4,
+        Tablet   = 1 << 5,
+    };
+
+    constexpr uint32_t EvDevClassCount = 6;
+
+    constexpr EvDevClass operator|(EvDevClass l, EvDevClass r) { return EvDevClass(uint32_t(l) | uint32_t(r)); }
+    constexpr bool operator&(EvDevClass l, EvDevClass r) { return uint32_t(l) & uint32_t(r); }
+
+    // Identity of a node, read from udev and sysfs without opening it
+
+    struct EvDevMetadata
+    {
+        EvDevClass classes = EvDevClass::None;
+        uint16_t vendor = 0;
+        uint16_t product = 0;
+        std::string name;
     };
 
+    // First filter stage, checked against udev metadata before a node is opened. Nodes that no filter's
+    //   match accepts are never opened. Unset fields match anything.
+    //
+    //   Filters are indexed by their most selective key (vendor + product, then name, then classes), so
+    //   a new device only visits the filters that could accept it, however many are registered.
+
+    struct EvDevMatch
+    {
+        EvDevClass classes = EvDevClass::None; // Any of
+        std::optional<uint16_t> vendor;
+        std::optional<uint16_t> product;
+        std::string name;
+
+        bool matches(const EvDevMetadata& metadata) const
+        {
+            if (classes != EvDevClass::None && !(classes & metadata.classes)) return false;
+            if (vendor && *vendor != metadata.vendor) return false;
+            if (product && *product != metadata.product) return false;
+            if (!name.empty() && name != metadata.name) return false;
+            return true;
+        }
+    };
+
+    // Second filter stage, run on the opened device with capabilities loaded. Returns true to keep the device
     using EvDevDeviceFilter = std::function<bool(EvInputDevice*)>;
-    using EvDevInputDeviceEventCallback = std::function<void(EvInputDevice*, EvDevInputDeviceEventType, input_event)>;
+    using EvDevInputDeviceEventCallback = InplaceFunction<void(EvInputDevice*, EvDevInputDeviceEventType, const input_event&)>;
+
+    // Device state after a frame, kept up to date as events are dispatched. Each field is a separate
+    //   dense array, so a consumer reading a handful of axes or keys touches only a few cache lines.
+    //   Changed masks cover the most recent frame only. Absolute axes are normalized together once the
+    //   whole frame has been applied.
+
+    struct EvDevState
+    {
+        // Absolute axes normalized to [-1, 1] over the axis range
+        std::array<float, ABS_CNT> abs = {};
+        BitSet<ABS_CNT> abs_changed;
+
+        BitSet<KEY_CNT> keys;
+        BitSet<KEY_CNT> keys_changed;
+        uint32_t held_count = 0;
+
+        // Relative motion summed over the most recent frame
+        std::array<int32_t, REL_CNT> rel = {};
+        BitSet<REL_CNT> rel_changed;
+    };
+
+    // Invoked once per complete frame, events include the terminating SYN_REPORT. State is empty on removal
+    using EvDevInputDeviceFrameCallback = InplaceFunction<void(EvInputDevice*, EvDevInputDeviceEventType, std::span<const input_event>, const EvDevState&)>;
+
+    // Type-erased frame sink, called as fn(sink, ...) with a single indirect call per frame
+    using EvDevInputDeviceFrameSinkFn = void(*)(void* sink, EvInputDevice*, EvDevInputDeviceEventType, std::span<const input_event>, const EvDevState&);
+
+    // Counters for kernel buffer overflows and the resyncs they trigger
+
+    struct EvDevStats
+    {
+        uint64_t drops = 0;         // SYN_DROPPED seen
+        uint64_t resyncs = 0;
+        uint64_t resync_events = 0; // Changes dispatched by resyncs
+        uint64_t resync_ns_total = 0;
+        uint64_t resync_ns_max = 0;
+    };
+
+    // Event codes supported by a device, captured once when the device is opened
+
+    struct EvDevCapabilities
+    {
+        BitSet<EV_CNT>  types;
+        BitSet<KEY_CNT> key;
+        BitSet<REL_CNT> rel;
+        BitSet<ABS_CNT> abs;
+        BitSet<MSC_CNT> msc;
+
+        bool has(uint32_t type, uint32_t code) const
+        {
+            switch (type) {
+                break;case EV_KEY: return key.test(code);
+                break;case EV_REL: return rel.test(code);
+                break;case EV_ABS: return abs.test(code);
+                break;case EV_MSC: return msc.test(code);
+                break;default:     return false;
+            }
+        }
+
+        uint32_t count(uint32_t type) const
+        {
+            switch (type) {
+                break;case EV_KEY: return key.count();
+                break;case EV_REL: return rel.count();
+                break;case EV_ABS: return abs.count();
+                break;case EV_MSC: return msc.count();
+                break;default:     return 0;
+            }
+        }
+
+        template<typename Fn>
+        void for_each_code(uint32_t type, Fn&& fn) const
+        {
+            switch (type) {
+                break;case EV_KEY: key.for_each(fn);
+                break;case EV_REL: rel.for_each(fn);
+                break;case EV_ABS: abs.for_each(fn);
+                break;case EV_MSC: msc.for_each(fn);
+            }
+        }
+    };
 
     struct EvInputDevice
     {
@@ -39,17 +180,63 @@ namespace input
         bool has_mouse();
         bool has_keyboard();
         bool has_cctrl();
+
+        const EvDevCapabilities& get_capabilities();
+
+        const EvDevState& get_state();
+
+        // Keys currently held down, tracked incrementally as events are dispatched
+        const BitSet<KEY_CNT>& get_pressed_keys();
+        uint32_t get_held_count();
+
+        // Enables every supported code of the given type on target, including absinfo for EV_ABS
+        void copy_capabilities(libevdev* target, uint32_t type);
+
+        // Time from kernel event timestamp to output write completion, for each forwarded frame
+        const LatencyHistogram& get_latency();
+
+        const EvDevStats& get_stats();
     };
 
     struct EvDevSubsystem : RefCounted
     {
         struct Impl;
 
-        static EvDevSubsystem* create(FdEventBus*, UDevSubsystem*);
+        // With reader_threads > 0, device fds are sharded across that many reader threads,
+        //   otherwise all devices are read directly on the event bus thread.
+        static EvDevSubsystem* create(FdEventBus*, UDevSubsystem*, uint32_t reader_threads = 0);
         static void destroy(EvDevSubsystem*);
 
     public:
         void register_device_filter(EvDevDeviceFilter&&);
+        void register_device_filter(EvDevMatch, EvDevDeviceFilter&&);
+
+        // Adds a device fed with raw input_events from a stand-in fd (e.g. a pipe), taking ownership of both
+        //   the (non-blocking) fd and the libevdev context describing its capabilities. End of file removes the device.
+        //   Filters are run as normal, but the device is always kept.
+        EvInputDevice* add_synthetic_device(int fd, libevdev* device);
         void register_input_device_event_callback(EvInputDevice* device, EvDevInputDeviceEventCallback&&);
+        void register_input_device_frame_callback(EvInputDevice* device, EvDevInputDeviceFrameCallback&&);
+
+        // Registers a caller-owned sink, invoked as sink(device, type, frame, state). The sink is referenced rather
+        //   than copied, so it may hold any amount of state, and each frame is a single call through a thunk that
+        //   invokes Sink's own operator() directly. Sinks run after a device's callbacks. The sink must outlive the device.
+        template<typename Sink>
+        void register_input_device_frame_sink(EvInputDevice* device, Sink& sink)
+        {
+            register_input_device_frame_sink(device, &sink, [](void* sink, EvInputDevice* device, EvDevInputDeviceEventType type,
+                    std::span<const input_event> frame, const EvDevState& state) {
+                (*static_cast<Sink*>(sink))(device, type, frame, state);
+            });
+        }
+
+        void register_input_device_frame_sink(EvInputDevice* device, void* sink, EvDevInputDeviceFrameSinkFn fn);
+
+        // Captures the raw event stream of every device accepted from now on into the given directory,
+        //   one recording per device. See InputRecorder for the format and InputReplay for playback.
+        void record_devices(std::string_view directory);
+
+        // Logs latency and drop statistics for every device
+        void report_latency();
     };
 }
@@ -2,32 +2,521 @@
 
 #include "core.hpp"
 
+#include <algorithm>
 #include <memory>
-#include <list>
+#include <deque>
+#include <vector>
+#include <array>
+#include <optional>
 
 #include <sys/epoll.h>
+#include <sys/timerfd.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <string.h>
 
+#if INPUT_HAS_IO_URING
+#include <liburing.h>
+#endif
+
 namespace input
 {
     struct FdEventHandler
     {
-        int fd;
+        int fd = -1;
+        uint32_t generation = 0;
+        uint32_t events = 0;
         FdEventCallback callback;
+        FdReadCallback read_callback;
+        FdReadBufferFn read_buffer;
     };
 
+    using TimePoint = std::chrono::steady_clock::time_point;
+
+    struct Timer
+    {
+        uint32_t generation = 0;
+        std::chrono::steady_clock::duration period = {};
+        TimerCallback callback;
+    };
+
+    struct TimerDeadline
+    {
+        TimePoint deadline;
+        TimerHandle handle;
+    };
+
+    // Inverted for use with std heap algorithms, which maintain a max-heap
+    static constexpr auto earliest_deadline_first = [](const TimerDeadline& l, const TimerDeadline& r) { return l.deadline > r.deadline; };
+
+    // Size of a single read performed on behalf of a reader (170 input_events)
+    static constexpr uint32_t ReadChunkSize = 4080;
+
+#if INPUT_HAS_IO_URING
+    static constexpr uint32_t UringNoWrite = UINT32_MAX;
+
+    struct UringWriteBuffer
+    {
+        int fd = -1;
+        uint32_t offset = 0; // Written so far, short writes are resubmitted from here
+        uint32_t next = UringNoWrite; // Next write queued to the same fd
+        std::vector<std::byte> data;
+    };
+
+    // Writes to a single fd. Writes may run in parallel in io-wq, so only the head is ever in flight and the
+    //   rest are submitted one at a time as each completes, which keeps them in order.
+    struct UringWriteQueue
+    {
+        int fd = -1;
+        uint32_t head = UringNoWrite;
+        uint32_t tail = UringNoWrite;
+        bool owns_fd = false; // fd is a duplicate made by flush_writes, closed once the queue drains
+    };
+
+    // Completions that don't belong to a handler are tagged with an invalid handler index
+    static constexpr uint32_t UringTagIndex = UINT32_MAX;
+    static constexpr uint32_t UringCancelTag = UINT32_MAX;
+
+    static constexpr uint32_t UringReadBufferCount = 64;
+    static constexpr int UringReadBufferGroup = 0;
+#endif
+
     struct FdEventBus::Impl : FdEventBus {
+        FdEventBusBackend backend;
+
         int epollfd = -1;
-        std::list<FdEventHandler> handlers;
+        std::unique_ptr<std::byte[]> read_scratch;
+
+#if INPUT_HAS_IO_URING
+        io_uring ring;
+        io_uring_buf_ring* read_buffer_ring = nullptr;
+        std::unique_ptr<std::byte[]> read_buffers;
+
+        // Staging for in-flight writes, recycled on completion
+        std::deque<UringWriteBuffer> write_buffers;
+        std::vector<uint32_t> free_write_buffers;
+        std::vector<UringWriteQueue> write_queues;
+#endif
+
+        // Slot map of handlers. Deque storage keeps slots stable while callbacks register new listeners.
+        std::deque<FdEventHandler> handlers;
+        std::vector<uint32_t> free_slots;
+
+        // Slots unregistered during dispatch, callbacks are destroyed once the current batch completes
+        bool dispatching = false;
+        std::vector<uint32_t> pending_free;
+
+        bool running = false;
+
+        // Timers. Cancelled timers are invalidated by generation and lazily discarded from the heap.
+        int timerfd = -1;
+        TimePoint armed_deadline = TimePoint::max();
+        std::deque<Timer> timers;
+        std::vector<uint32_t> free_timer_slots;
+        std::vector<TimerDeadline> timer_heap;
     };
 
-    FdEventBus* FdEventBus::create()
+    namespace
+    {
+        uint64_t pack_handle(FdListenerHandle handle)
+        {
+            return uint64_t(handle.generation) << 32 | handle.index;
+        }
+
+        FdListenerHandle unpack_handle(uint64_t packed)
+        {
+            return { .index = uint32_t(packed), .generation = uint32_t(packed >> 32) };
+        }
+
+        void release_slot(FdEventBus::Impl* self, uint32_t index)
+        {
+            self->handlers[index].callback = nullptr;
+            self->handlers[index].read_callback = nullptr;
+            self->handlers[index].read_buffer = nullptr;
+            self->free_slots.emplace_back(index);
+        }
+
+        FdListenerHandle allocate_slot(FdEventBus::Impl* self, int fd, uint32_t events)
+        {
+            uint32_t index;
+            if (self->free_slots.empty()) {
+                index = uint32_t(self->handlers.size());
+                self->handlers.emplace_back();
+            } else {
+                index = self->free_slots.back();
+                self->free_slots.pop_back();
+            }
+
+            auto& handler = self->handlers[index];
+            handler.fd = fd;
+            handler.events = events;
+
+            return { .index = index, .generation = handler.generation };
+        }
+
+        bool is_handler_live(FdEventBus::Impl* self, FdListenerHandle handle)
+        {
+            return handle && handle.index < self->handlers.size() && self->handlers[handle.index].generation == handle.generation;
+        }
+
+        void write_all(int fd, std::span<const std::byte> data)
+        {
+            while (!data.empty()) {
+                auto written = unix_check_n1(::write(fd, data.data(), data.size()), EINTR);
+                if (written <= 0) continue;
+                data = data.subspan(written);
+            }
+        }
+
+// -----------------------------------------------------------------------------
+
+        void epoll_read_fd(FdEventBus::Impl* self, FdListenerHandle handle)
+        {
+            auto& handler = self->handlers[handle.index];
+
+            for (;;) {
+                auto buffer = handler.read_buffer
+                    ? handler.read_buffer()
+                    : std::span(self->read_scratch.get(), ReadChunkSize);
+
+                auto res = read(handler.fd, buffer.data(), buffer.size());
+                if (res == -1) {
+                    if (errno == EINTR) continue;
+                    if (errno == EAGAIN) return;
+                    handler.read_callback(FdReadData { .fd = handler.fd, .error = errno });
+                    return;
+                }
+
+                handler.read_callback(FdReadData { .fd = handler.fd, .data{buffer.data(), size_t(res)} });
+
+                // Reader may have unregistered itself. Otherwise stop after a short read, the fd has been drained
+                if (handler.generation != handle.generation || size_t(res) < buffer.size()) return;
+            }
+        }
+
+        void epoll_run_once(FdEventBus::Impl* self)
+        {
+            epoll_event events[16];
+            auto events_ready = unix_check_n1(epoll_wait(self->epollfd, events, std::size(events), -1), EINTR);
+            if (events_ready <= 0) return;
+
+            for (int i = 0; i < events_ready; ++i) {
+                auto handle = unpack_handle(events[i].data.u64);
+                auto& handler = self->handlers[handle.index];
+                if (handler.generation != handle.generation) continue;
+
+                if (handler.read_callback) {
+                    epoll_read_fd(self, handle);
+                } else {
+                    handler.callback(FdEventData {
+                        .fd = handler.fd,
+                        .events = events[i].events
+                    });
+                }
+            }
+        }
+
+// -----------------------------------------------------------------------------
+
+#if INPUT_HAS_IO_URING
+        io_uring_sqe* uring_get_sqe(FdEventBus::Impl* self)
+        {
+            auto sqe = io_uring_get_sqe(&self->ring);
+            if (!sqe) {
+                // Submission queue full, flush what we have and try again
+                unix_check_ne(io_uring_submit(&self->ring));
+                sqe = io_uring_get_sqe(&self->ring);
+                if (!sqe) raise_error("io_uring: failed to acquire SQE");
+            }
+            return sqe;
+        }
+
+        void uring_arm(FdEventBus::Impl* self, FdListenerHandle handle)
+        {
+            auto& handler = self->handlers[handle.index];
+            auto sqe = uring_get_sqe(self);
+            if (handler.read_callback) {
+                io_uring_prep_read_multishot(sqe, handler.fd, 0, 0, UringReadBufferGroup);
+            } else {
+                io_uring_prep_poll_multishot(sqe, handler.fd, handler.events);
+            }
+            io_uring_sqe_set_data64(sqe, pack_handle(handle));
+        }
+
+        void uring_cancel(FdEventBus::Impl* self, FdListenerHandle handle)
+        {
+            auto sqe = uring_get_sqe(self);
+            io_uring_prep_cancel64(sqe, pack_handle(handle), 0);
+            io_uring_sqe_set_data64(sqe, pack_handle({ .index = UringTagIndex, .generation = UringCancelTag }));
+        }
+
+        void uring_recycle_read_buffer(FdEventBus::Impl* self, uint16_t buffer_id)
+        {
+            io_uring_buf_ring_add(self->read_buffer_ring, self->read_buffers.get() + size_t(buffer_id) * ReadChunkSize,
+                ReadChunkSize, buffer_id, io_uring_buf_ring_mask(UringReadBufferCount), 0);
+            io_uring_buf_ring_advance(self->read_buffer_ring, 1);
+        }
+
+        void uring_submit_write(FdEventBus::Impl* self, uint32_t index)
+        {
+            auto& buffer = self->write_buffers[index];
+            auto sqe = uring_get_sqe(self);
+            io_uring_prep_write(sqe, buffer.fd, buffer.data.data() + buffer.offset, uint32_t(buffer.data.size() - buffer.offset), 0);
+            io_uring_sqe_set_data64(sqe, pack_handle({ .index = UringTagIndex, .generation = index }));
+        }
+
+        void uring_write(FdEventBus::Impl* self, int fd, std::span<const std::byte> data)
+        {
+            uint32_t index;
+            if (self->free_write_buffers.empty()) {
+                index = uint32_t(self->write_buffers.size());
+                self->write_buffers.emplace_back();
+            } else {
+                index = self->free_write_buffers.back();
+                self->free_write_buffers.pop_back();
+            }
+
+            auto& buffer = self->write_buffers[index];
+            buffer.fd = fd;
+            buffer.offset = 0;
+            buffer.next = UringNoWrite;
+            buffer.data.assign(data.begin(), data.end());
+
+            // Not linked, as a link would fail every queued write on a short one and chain in unrelated SQEs
+            auto queue = std::ranges::find(self->write_queues, fd, &UringWriteQueue::fd);
+            if (queue != self->write_queues.end()) {
+                self->write_buffers[queue->tail].next = index;
+                queue->tail = index;
+                return;
+            }
+
+            self->write_queues.emplace_back(UringWriteQueue { .fd = fd, .head = index, .tail = index });
+            uring_submit_write(self, index);
+        }
+
+        void uring_complete_write(FdEventBus::Impl* self, uint32_t index)
+        {
+            auto& buffer = self->write_buffers[index];
+            auto queue = std::ranges::find(self->write_queues, buffer.fd, &UringWriteQueue::fd);
+            auto next = buffer.next;
+            self->free_write_buffers.emplace_back(index);
+
+            if (next != UringNoWrite) {
+                queue->head = next;
+                uring_submit_write(self, next);
+                return;
+            }
+
+            if (queue->owns_fd) close(queue->fd);
+            *queue = self->write_queues.back();
+            self->write_queues.pop_back();
+        }
+
+        void uring_handle_cqe(FdEventBus::Impl* self, const io_uring_cqe& cqe)
+        {
+            auto handle = unpack_handle(cqe.user_data);
+
+            if (handle.index == UringTagIndex) {
+                if (handle.generation == UringCancelTag) return;
+
+                auto& buffer = self->write_buffers[handle.generation];
+                if (cqe.res < 0) {
+                    log_error("io_uring write to fd {} failed: ({}) {}", buffer.fd, -cqe.res, strerror(-cqe.res));
+                } else {
+                    // Short write, resubmit the remainder. Still the head of its queue, so still in order
+                    buffer.offset += uint32_t(cqe.res);
+                    if (cqe.res > 0 && buffer.offset < buffer.data.size()) {
+                        uring_submit_write(self, handle.generation);
+                        return;
+                    }
+                }
+                uring_complete_write(self, handle.generation);
+                return;
+            }
+
+            std::optional<uint16_t> buffer_id;
+            if (cqe.flags & IORING_CQE_F_BUFFER) buffer_id = uint16_t(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+            defer { if (buffer_id) uring_recycle_read_buffer(self, *buffer_id); };
+
+            if (!is_handler_live(self, handle)) return;
+            auto& handler = self->handlers[handle.index];
+
+            if (handler.read_callback) {
+                if (cqe.res == 0) {
+                    handler.read_callback(FdReadData { .fd = handler.fd });
+                } else if (cqe.res > 0 && buffer_id) {
+                    handler.read_callback(FdReadData {
+                        .fd = handler.fd,
+                        .data{self->read_buffers.get() + size_t(*buffer_id) * ReadChunkSize, size_t(cqe.res)},
+                    });
+                } else if (cqe.res < 0 && cqe.res != -ENOBUFS && cqe.res != -ECANCELED) {
+                    handler.read_callback(FdReadData { .fd = handler.fd, .error = -cqe.res });
+                }
+            } else if (cqe.res < 0) {
+                if (cqe.res != -ECANCELED) log_error("io_uring poll failed on fd {}: ({}) {}", handler.fd, -cqe.res, strerror(-cqe.res));
+            } else {
+                handler.callback(FdEventData {
+                    .fd = handler.fd,
+                    .events = uint32_t(cqe.res),
+                });
+            }
+
+            // Multishot requests terminate on error or buffer exhaustion, re-arm if still registered
+            if (!(cqe.flags & IORING_CQE_F_MORE) && is_handler_live(self, handle)) {
+                uring_arm(self, handle);
+            }
+        }
+
+        void uring_run_once(FdEventBus::Impl* self)
+        {
+            // Submits any queued writes and re-arms alongside the wait, in a single io_uring_enter
+
+            unix_check_ne(io_uring_submit_and_wait(&self->ring, 1), EINTR);
+
+            io_uring_cqe* cqes[64];
+            auto count = io_uring_peek_batch_cqe(&self->ring, cqes, std::size(cqes));
+
+            // Copy out completions so that callbacks can queue new submissions freely
+            std::array<io_uring_cqe, std::size(cqes)> completions;
+            for (uint32_t i = 0; i < count; ++i) completions[i] = *cqes[i];
+            io_uring_cq_advance(&self->ring, count);
+
+            for (uint32_t i = 0; i < count; ++i) uring_handle_cqe(self, completions[i]);
+        }
+#endif
+
+        bool is_timer_live(FdEventBus::Impl* self, TimerHandle handle)
+        {
+            return handle.index < self->timers.size() && self->timers[handle.index].generation == handle.generation;
+        }
+
+        void release_timer(FdEventBus::Impl* self, uint32_t index)
+        {
+            auto& timer = self->timers[index];
+            timer.generation++;
+            timer.callback = nullptr;
+            self->free_timer_slots.emplace_back(index);
+        }
+
+        void arm_timerfd(FdEventBus::Impl* self)
+        {
+            // Discard cancelled timers so they don't cause spurious wakeups
+
+            while (!self->timer_heap.empty() && !is_timer_live(self, self->timer_heap.front().handle)) {
+                std::ranges::pop_heap(self->timer_heap, earliest_deadline_first);
+                self->timer_heap.pop_back();
+            }
+
+            auto deadline = self->timer_heap.empty() ? TimePoint::max() : self->timer_heap.front().deadline;
+            if (deadline == self->armed_deadline) return;
+            self->armed_deadline = deadline;
+
+            itimerspec spec = {};
+            if (deadline != TimePoint::max()) {
+                // steady_clock is CLOCK_MONOTONIC, a zeroed it_value would disarm the timer so clamp to at least 1ns
+                auto ns = std::max<int64_t>(1, std::chrono::duration_cast<std::chrono::nanoseconds>(deadline.time_since_epoch()).count());
+                spec.it_value = { .tv_sec = ns / 1'000'000'000, .tv_nsec = ns % 1'000'000'000 };
+            }
+            unix_check_n1(timerfd_settime(self->timerfd, TFD_TIMER_ABSTIME, &spec, nullptr));
+        }
+
+        TimerHandle add_timer(FdEventBus::Impl* self, TimePoint deadline, std::chrono::steady_clock::duration period, TimerCallback&& fn)
+        {
+            uint32_t index;
+            if (self->free_timer_slots.empty()) {
+                index = uint32_t(self->timers.size());
+                self->timers.emplace_back();
+            } else {
+                index = self->free_timer_slots.back();
+                self->free_timer_slots.pop_back();
+            }
+
+            auto& timer = self->timers[index];
+            timer.period = period;
+            timer.callback = std::move(fn);
+
+            TimerHandle handle { .index = index, .generation = timer.generation };
+            self->timer_heap.emplace_back(deadline, handle);
+            std::ranges::push_heap(self->timer_heap, earliest_deadline_first);
+
+            if (deadline < self->armed_deadline) arm_timerfd(self);
+
+            return handle;
+        }
+
+        void handle_timers(FdEventBus::Impl* self)
+        {
+            uint64_t expirations;
+            unix_check_n1(read(self->timerfd, &expirations, sizeof(expirations)), EAGAIN);
+
+            // Force a re-arm after processing, the kernel has disarmed the expired deadline
+            self->armed_deadline = TimePoint::min();
+
+            auto now = std::chrono::steady_clock::now();
+            while (!self->timer_heap.empty() && self->timer_heap.front().deadline <= now) {
+                std::ranges::pop_heap(self->timer_heap, earliest_deadline_first);
+                auto expired = self->timer_heap.back();
+                self->timer_heap.pop_back();
+
+                if (!is_timer_live(self, expired.handle)) continue;
+                auto& timer = self->timers[expired.handle.index];
+
+                if (timer.period.count()) {
+                    // Reschedule before invoking, so that the callback may cancel itself
+
+                    auto deadline = expired.deadline + timer.period;
+                    if (deadline <= now) deadline += ((now - deadline) / timer.period + 1) * timer.period;
+                    self->timer_heap.emplace_back(deadline, expired.handle);
+                    std::ranges::push_heap(self->timer_heap, earliest_deadline_first);
+
+                    // Invoke from outside the timer table, which the callback may grow or release its own slot in
+                    auto callback = std::move(timer.callback);
+                    callback();
+                    if (is_timer_live(self, expired.handle)) self->timers[expired.handle.index].callback = std::move(callback);
+                } else {
+                    auto callback = std::move(timer.callback);
+                    release_timer(self, expired.handle.index);
+                    callback();
+                }
+            }
+
+            arm_timerfd(self);
+        }
+    }
+
+    FdEventBus* FdEventBus::create(FdEventBusBackend backend)
     {
         auto bus = new FdEventBus::Impl;
         defer { unref(bus); };
-        bus->epollfd = epoll_create1(0);
+        bus->backend = backend;
+        bus->read_scratch.reset(new std::byte[ReadChunkSize]);
+
+        switch (backend) {
+            break;case FdEventBusBackend::Epoll:
+                bus->epollfd = unix_check_n1(epoll_create1(EPOLL_CLOEXEC));
+            break;case FdEventBusBackend::IoUring: {
+#if INPUT_HAS_IO_URING
+                unix_check_ne(io_uring_queue_init(256, &bus->ring, 0));
+
+                int res = 0;
+                bus->read_buffer_ring = io_uring_setup_buf_ring(&bus->ring, UringReadBufferCount, UringReadBufferGroup, 0, &res);
+                if (!bus->read_buffer_ring) raise_unix_error("io_uring_setup_buf_ring", -res);
+
+                bus->read_buffers.reset(new std::byte[size_t(UringReadBufferCount) * ReadChunkSize]);
+                for (uint32_t i = 0; i < UringReadBufferCount; ++i) {
+                    uring_recycle_read_buffer(bus, uint16_t(i));
+                }
+#else
+                raise_error("io_uring backend not available in this build (enable INPUT_IO_URING)");
+#endif
+            }
+        }
+
+        bus->timerfd = unix_check_n1(timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC));
+        bus->register_fd_listener(bus->timerfd, EPOLLIN, [bus](FdEventData) {
+            handle_timers(bus);
+        });
+
         return take(bus);
     }
 
@@ -35,53 +524,183 @@ namespace input
     {
         decl_self(_self);
 
-        close(self->epollfd);
+        close(self->timerfd);
+        if (self->epollfd != -1) close(self->epollfd);
+#if INPUT_HAS_IO_URING
+        if (self->backend == FdEventBusBackend::IoUring) {
+            for (auto& queue : self->write_queues) {
+                if (queue.owns_fd) close(queue.fd);
+            }
+            if (self->read_buffer_ring) io_uring_free_buf_ring(&self->ring, self->read_buffer_ring, UringReadBufferCount, UringReadBufferGroup);
+            io_uring_queue_exit(&self->ring);
+        }
+#endif
         delete self;
     }
 
-    void FdEventBus::register_fd_listener(int fd, uint32_t events, FdEventCallback&& fn)
+    namespace
+    {
+        void add_handler(FdEventBus::Impl* self, FdListenerHandle handle)
+        {
+            auto& handler = self->handlers[handle.index];
+
+#if INPUT_HAS_IO_URING
+            if (self->backend == FdEventBusBackend::IoUring) {
+                uring_arm(self, handle);
+                return;
+            }
+#endif
+            epoll_event event {
+                .events = handler.events,
+                .data{.u64 = pack_handle(handle)},
+            };
+            unix_check_n1(epoll_ctl(self->epollfd, EPOLL_CTL_ADD, handler.fd, &event));
+        }
+    }
+
+    FdListenerHandle FdEventBus::register_fd_listener(int fd, uint32_t events, FdEventCallback&& fn)
     {
         decl_self(this);
 
-        epoll_event event {
-            .events = events,
-            .data{.ptr = &self->handlers.emplace_back(fd, fn)},
-        };
-        unix_check_n1(epoll_ctl(self->epollfd, EPOLL_CTL_ADD, fd, &event));
+        auto handle = allocate_slot(self, fd, events);
+        self->handlers[handle.index].callback = std::move(fn);
+        add_handler(self, handle);
+
+        return handle;
     }
 
-    void FdEventBus::unregister_fd_listener(int fd)
+    FdListenerHandle FdEventBus::register_fd_reader(int fd, FdReadCallback&& fn, FdReadBufferFn&& buffer)
     {
         decl_self(this);
 
-        auto iter = std::ranges::find_if(self->handlers, [&](auto& handler) { return handler.fd == fd; });
-        if (iter == self->handlers.end()) {
-            log_warn("File descriptor {} not found in registered list", fd);
+        auto handle = allocate_slot(self, fd, EPOLLIN);
+        self->handlers[handle.index].read_callback = std::move(fn);
+        self->handlers[handle.index].read_buffer = std::move(buffer);
+        add_handler(self, handle);
+
+        return handle;
+    }
+
+    void FdEventBus::unregister_fd_listener(FdListenerHandle handle)
+    {
+        decl_self(this);
+
+        if (!is_handler_live(self, handle)) {
+            log_warn("Listener handle ({}, {}) not found in registered list", handle.index, handle.generation);
             return;
         }
 
-        unix_check_n1(epoll_ctl(self->epollfd, EPOLL_CTL_DEL, iter->fd, nullptr));
-        self->handlers.erase(iter);
+        auto& handler = self->handlers[handle.index];
+#if INPUT_HAS_IO_URING
+        if (self->backend == FdEventBusBackend::IoUring) {
+            uring_cancel(self, handle);
+        } else
+#endif
+        {
+            unix_check_n1(epoll_ctl(self->epollfd, EPOLL_CTL_DEL, handler.fd, nullptr));
+        }
+
+        // Invalidate immediately so that any events for this slot remaining in the current batch are dropped
+
+        handler.generation++;
+        auto fd = std::exchange(handler.fd, -1);
+
+        if (self->dispatching) {
+            self->pending_free.emplace_back(handle.index);
+        } else {
+            release_slot(self, handle.index);
+        }
 
         log_debug("Successfully unregistered file descriptor: {}", fd);
     }
 
-    void FdEventBus::run()
+    void FdEventBus::write(int fd, std::span<const std::byte> data)
     {
         decl_self(this);
 
-        for (;;) {
-            epoll_event events[16];
-            auto events_ready = unix_check_n1(epoll_wait(self->epollfd, events, std::size(events), -1), EINTR);
-            if (events_ready <= 0) continue;
+        if (data.empty()) return;
 
-            for (int i = 0; i < events_ready; ++i) {
-                auto* handler = static_cast<FdEventHandler*>(events[i].data.ptr);
-                handler->callback(FdEventData {
-                    .fd = handler->fd,
-                    .events = events[i].events
-                });
+#if INPUT_HAS_IO_URING
+        if (self->backend == FdEventBusBackend::IoUring) {
+            uring_write(self, fd, data);
+            return;
+        }
+#endif
+        write_all(fd, data);
+    }
+
+    void FdEventBus::flush_writes(int fd)
+    {
+        decl_self(this);
+
+#if INPUT_HAS_IO_URING
+        if (self->backend == FdEventBusBackend::IoUring) {
+            // Submitted requests hold their own reference to the file, but queued writes and short write
+            //   resubmits still need an fd. Move them onto a duplicate that lives until the queue drains.
+            auto queue = std::ranges::find(self->write_queues, fd, &UringWriteQueue::fd);
+            if (queue != self->write_queues.end()) {
+                auto dup_fd = unix_check_n1(fcntl(fd, F_DUPFD_CLOEXEC, 0));
+                queue->fd = dup_fd;
+                queue->owns_fd = true;
+                for (auto i = queue->head; i != UringNoWrite; i = self->write_buffers[i].next) {
+                    self->write_buffers[i].fd = dup_fd;
+                }
             }
+            unix_check_ne(io_uring_submit(&self->ring));
         }
+#endif
+    }
+
+    TimerHandle FdEventBus::schedule_after(std::chrono::steady_clock::duration delay, TimerCallback&& fn)
+    {
+        decl_self(this);
+
+        return add_timer(self, std::chrono::steady_clock::now() + delay, {}, std::move(fn));
+    }
+
+    TimerHandle FdEventBus::schedule_every(std::chrono::steady_clock::duration period, TimerCallback&& fn)
+    {
+        decl_self(this);
+
+        if (period.count() <= 0) raise_error("Timer period must be positive");
+
+        return add_timer(self, std::chrono::steady_clock::now() + period, period, std::move(fn));
+    }
+
+    void FdEventBus::cancel(TimerHandle handle)
+    {
+        decl_self(this);
+
+        if (!is_timer_live(self, handle)) return;
+
+        // Heap entry is discarded lazily when it reaches the top
+        release_timer(self, handle.index);
+    }
+
+    void FdEventBus::run()
+    {
+        decl_self(this);
+
+        self->running = true;
+        while (self->running) {
+            self->dispatching = true;
+#if INPUT_HAS_IO_URING
+            if (self->backend == FdEventBusBackend::IoUring) {
+                uring_run_once(self);
+            } else
+#endif
+            {
+                epoll_run_once(self);
+            }
+            self->dispatching = false;
+
+            for (auto index : self->pending_free) release_slot(self, index);
+            self->pending_free.clear();
+        }
+    }
+
+    void FdEventBus::stop()
+    {
+        get_impl(this)->running = false;
     }
 }
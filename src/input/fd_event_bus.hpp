@@ -1,8 +1,10 @@
 #pragma once
 
 #include "core.hpp"
+#include "inplace_function.hpp"
 
-#include <functional>
+#include <chrono>
+#include <span>
 
 #include <sys/epoll.h>
 
@@ -14,18 +16,82 @@ namespace input
         uint32_t events;
     };
 
-    using FdEventCallback = std::function<void(FdEventData)>;
+    using FdEventCallback = InplaceFunction<void(FdEventData)>;
+
+    struct FdReadData
+    {
+        int fd;
+        std::span<const std::byte> data;
+        int error; // errno of a failed read, data is empty. Empty data without an error is end of file
+    };
+
+    using FdReadCallback = InplaceFunction<void(FdReadData)>;
+
+    // Supplies the destination for the next read, so that data can land where the reader keeps it
+    using FdReadBufferFn = InplaceFunction<std::span<std::byte>()>;
+
+    enum class FdEventBusBackend
+    {
+        Epoll,
+
+        // Requires a build with INPUT_IO_URING enabled. Readers use multishot reads into a shared
+        //   provided buffer ring, and writes are queued as SQEs submitted together with the wait.
+        IoUring,
+    };
+
+    // Generational handle to a registered listener. Handles are never reused with the same
+    //   generation, so stale handles (and stale events queued against them) are safely ignored.
+    struct FdListenerHandle
+    {
+        uint32_t index = UINT32_MAX;
+        uint32_t generation = 0;
+
+        explicit operator bool() const { return index != UINT32_MAX; }
+    };
+
+    using TimerCallback = InplaceFunction<void()>;
+
+    struct TimerHandle
+    {
+        uint32_t index = UINT32_MAX;
+        uint32_t generation = 0;
+
+        explicit operator bool() const { return index != UINT32_MAX; }
+    };
 
     struct FdEventBus : RefCounted
     {
         struct Impl;
 
-        static FdEventBus* create();
+        static FdEventBus* create(FdEventBusBackend backend = FdEventBusBackend::Epoll);
         static void destroy(FdEventBus*);
 
     public:
-        void register_fd_listener(int fd, uint32_t events, FdEventCallback&& callback);
-        void unregister_fd_listener(int fd);
+        FdListenerHandle register_fd_listener(int fd, uint32_t events, FdEventCallback&& callback);
+        void unregister_fd_listener(FdListenerHandle handle);
+
+        // Reads are performed by the bus and handed to the callback, so that the backend can batch them.
+        //   With epoll, reads go straight into the buffer supplied by `buffer` if given. io_uring always
+        //   reads into its own provided buffers.
+        FdListenerHandle register_fd_reader(int fd, FdReadCallback&& callback, FdReadBufferFn&& buffer = {});
+
+        // Data is copied, with io_uring the write is submitted on the next wait. Writes to the same fd
+        //   always complete in the order they were issued.
+        void write(int fd, std::span<const std::byte> data);
+
+        // Submits writes now and detaches any still queued for `fd` from it. Call before closing an fd that
+        //   has been written to through the bus.
+        void flush_writes(int fd);
+
+        // Timers are multiplexed onto a single timerfd, ordered by a min-heap of deadlines.
+        //   Periodic timers run at a fixed rate, ticks missed while the bus was busy are skipped.
+        TimerHandle schedule_after(std::chrono::steady_clock::duration delay, TimerCallback&& callback);
+        TimerHandle schedule_every(std::chrono::steady_clock::duration period, TimerCallback&& callback);
+        void cancel(TimerHandle handle);
+
         void run();
+
+        // Causes run() to return once the current batch of events has been dispatched
+        void stop();
     };
 }
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace input
+{
+    // Move-only replacement for std::function that stores the callable inline and never allocates.
+    //   Callables that don't fit are rejected at compile time, so large state must be held by pointer
+    //   (e.g. a captured unique_ptr, allocated once at registration rather than per call).
+
+    template<typename Sig, size_t Capacity = 64>
+    class InplaceFunction;
+
+    template<typename R, typename... Args, size_t Capacity>
+    class InplaceFunction<R(Args...), Capacity>
+    {
+        struct Ops
+        {
+            R(*invoke)(void*, Args&&...);
+            void(*relocate)(void* dst, void* src); // Move constructs dst from src, then destroys src
+            void(*destroy)(void*);
+        };
+
+        template<typename Fn>
+        static constexpr Ops OpsFor {
+            .invoke = [](void* fn, Args&&... args) -> R {
+                return std::invoke_r<R>(*static_cast<Fn*>(fn), std::forward<Args>(args)...);
+            },
+            .relocate = [](void* dst, void* src) {
+                new (dst) Fn(std::move(*static_cast<Fn*>(src)));
+                static_cast<Fn*>(src)->~Fn();
+            },
+            .destroy = [](void* fn) {
+                static_cast<Fn*>(fn)->~Fn();
+            },
+        };
+
+        alignas(std::max_align_t) mutable std::byte storage[Capacity];
+        const Ops* ops = nullptr;
+
+    public:
+        InplaceFunction() = default;
+        InplaceFunction(std::nullptr_t) {}
+
+        template<typename Fn>
+            requires (!std::is_same_v<std::remove_cvref_t<Fn>, InplaceFunction>
+                && std::is_invocable_r_v<R, std::decay_t<Fn>&, Args...>)
+        InplaceFunction(Fn&& fn)
+        {
+            using Stored = std::decay_t<Fn>;
+            static_assert(sizeof(Stored) <= Capacity, "Callable too large for InplaceFunction, hold large state by pointer");
+            static_assert(alignof(Stored) <= alignof(std::max_align_t));
+
+            new (storage) Stored(std::forward<Fn>(fn));
+            ops = &OpsFor<Stored>;
+        }
+
+        InplaceFunction(InplaceFunction&& other) noexcept
+        {
+            take(other);
+        }
+
+        InplaceFunction& operator=(InplaceFunction&& other) noexcept
+        {
+            if (this != &other) {
+                reset();
+                take(other);
+            }
+            return *this;
+        }
+
+        InplaceFunction& operator=(std::nullptr_t)
+        {
+            reset();
+            return *this;
+        }
+
+        ~InplaceFunction()
+        {
+            reset();
+        }
+
+        void reset()
+        {
+            if (!ops) return;
+            ops->destroy(storage);
+            ops = nullptr;
+        }
+
+        explicit operator bool() const { return ops; }
+
+        R operator()(Args... args) const
+        {
+            return ops->invoke(storage, std::forward<Args>(args)...);
+        }
+
+    private:
+        void take(InplaceFunction& other)
+        {
+            if (!other.ops) return;
+            other.ops->relocate(storage, other.storage);
+            ops = std::exchange(other.ops, nullptr);
+        }
+    };
+
+// -----------------------------------------------------------------------------
+
+    // Non-owning reference to a callable, an object pointer and a thunk. The callable must outlive it.
+
+    template<typename Sig>
+    class FunctionRef;
+
+    template<typename R, typename... Args>
+    class FunctionRef<R(Args...)>
+    {
+        void* object;
+        R(*invoke)(void*, Args&&...);
+
+    public:
+        template<typename Fn>
+            requires (!std::is_same_v<std::remove_cvref_t<Fn>, FunctionRef>
+                && std::is_invocable_r_v<R, Fn&, Args...>)
+        FunctionRef(Fn& fn)
+            : object(const_cast<void*>(static_cast<const void*>(std::addressof(fn))))
+            , invoke([](void* object, Args&&... args) -> R {
+                return std::invoke_r<R>(*static_cast<Fn*>(object), std::forward<Args>(args)...);
+            })
+        {}
+
+        R operator()(Args... args) const
+        {
+            return invoke(object, std::forward<Args>(args)...);
+        }
+    };
+}
@@ -0,0 +1,491 @@
+#include "input_recording.hpp"
+
+#include <cstring>
+#include <optional>
+#include <string>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace input
+{
+    namespace
+    {
+        constexpr std::string_view RecordingMagic = "INREC";
+        constexpr uint32_t RecordingVersion = 1;
+
+        // Codes are below KEY_CNT (0x300), leaving the upper bits for the event type
+        constexpr uint32_t RecordingCodeBits = 10;
+
+        constexpr size_t RecorderFlushThreshold = 64 * 1024;
+
+        uint64_t zigzag_encode(int64_t v) { return (uint64_t(v) << 1) ^ uint64_t(v >> 63); }
+        int64_t  zigzag_decode(uint64_t v) { return int64_t(v >> 1) ^ -int64_t(v & 1); }
+
+        void put_varint(std::vector<std::byte>& out, uint64_t v)
+        {
+            while (v >= 0x80) {
+                out.push_back(std::byte((v & 0x7f) | 0x80));
+                v >>= 7;
+            }
+            out.push_back(std::byte(v));
+        }
+
+        void put_svarint(std::vector<std::byte>& out, int64_t v)
+        {
+            put_varint(out, zigzag_encode(v));
+        }
+
+        void put_string(std::vector<std::byte>& out, std::string_view str)
+        {
+            put_varint(out, str.size());
+            auto bytes = std::as_bytes(std::span(str));
+            out.insert(out.end(), bytes.begin(), bytes.end());
+        }
+
+        int64_t to_us(const timeval& time)
+        {
+            return int64_t(time.tv_sec) * 1'000'000 + time.tv_usec;
+        }
+
+        timeval from_us(int64_t us)
+        {
+            return timeval { .tv_sec = us / 1'000'000, .tv_usec = us % 1'000'000 };
+        }
+
+        timeval now_monotonic()
+        {
+            timespec now;
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            return timeval { .tv_sec = now.tv_sec, .tv_usec = now.tv_nsec / 1000 };
+        }
+    }
+
+// -----------------------------------------------------------------------------
+
+    InputRecorder::InputRecorder(int _fd, libevdev* device)
+        : fd(_fd)
+    {
+        buffer.reserve(RecorderFlushThreshold * 2);
+
+        auto magic = std::as_bytes(std::span(RecordingMagic));
+        buffer.insert(buffer.end(), magic.begin(), magic.end());
+        put_varint(buffer, RecordingVersion);
+
+        put_string(buffer, libevdev_get_name(device) ?: "");
+        put_varint(buffer, libevdev_get_id_bustype(device));
+        put_varint(buffer, libevdev_get_id_vendor(device));
+        put_varint(buffer, libevdev_get_id_product(device));
+        put_varint(buffer, libevdev_get_id_version(device));
+
+        std::vector<uint32_t> props;
+        for (uint32_t prop = 0; prop <= INPUT_PROP_MAX; ++prop) {
+            if (libevdev_has_property(device, prop)) props.emplace_back(prop);
+        }
+        put_varint(buffer, props.size());
+        for (auto prop : props) put_varint(buffer, prop);
+
+        std::vector<std::pair<uint32_t, uint32_t>> codes;
+        for (uint32_t type = 0; type <= EV_MAX; ++type) {
+            if (!libevdev_has_event_type(device, type)) continue;
+            auto max = libevdev_event_type_get_max(type);
+            for (int code = 0; code <= max; ++code) {
+                if (libevdev_has_event_code(device, type, code)) codes.emplace_back(type, code);
+            }
+        }
+        put_varint(buffer, codes.size());
+        for (auto[type, code] : codes) {
+            put_varint(buffer, type << RecordingCodeBits | code);
+            if (type == EV_ABS) {
+                auto info = libevdev_get_abs_info(device, code);
+                put_svarint(buffer, info->value);
+                put_svarint(buffer, info->minimum);
+                put_svarint(buffer, info->maximum);
+                put_svarint(buffer, info->fuzz);
+                put_svarint(buffer, info->flat);
+                put_svarint(buffer, info->resolution);
+            } else if (type == EV_REP) {
+                put_svarint(buffer, libevdev_get_event_value(device, type, code));
+            }
+        }
+
+        writer = std::jthread([this] {
+            std::unique_lock lock{mutex};
+            for (;;) {
+                wake.wait(lock, [&] { return stopping || !pending.empty(); });
+                if (pending.empty()) return;
+
+                auto writing = std::move(pending);
+                pending.clear();
+                lock.unlock();
+
+                for (auto& data : writing) {
+                    auto bytes = std::span(data);
+                    while (!bytes.empty()) {
+                        auto written = ::write(fd, bytes.data(), bytes.size());
+                        if (written < 0) {
+                            if (errno == EINTR) continue;
+                            log_error("Failed to write recording: ({}) {}", errno, strerror(errno));
+                            break;
+                        }
+                        bytes = bytes.subspan(written);
+                    }
+                    data.clear();
+                }
+
+                lock.lock();
+                for (auto& data : writing) spare.emplace_back(std::move(data));
+            }
+        });
+
+        // Header goes out straight away, so even a recording that captures nothing can be opened
+        flush();
+    }
+
+    InputRecorder::~InputRecorder()
+    {
+        flush();
+        {
+            std::scoped_lock lock{mutex};
+            stopping = true;
+        }
+        wake.notify_one();
+        writer.join();
+        close(fd);
+    }
+
+    void InputRecorder::record(std::span<const input_event> frame)
+    {
+        for (auto& ev : frame) {
+            auto time = to_us(ev.time);
+            put_svarint(buffer, time - last_time_us);
+            put_varint(buffer, uint32_t(ev.type) << RecordingCodeBits | ev.code);
+            put_svarint(buffer, ev.value);
+            last_time_us = time;
+        }
+
+        if (buffer.size() >= RecorderFlushThreshold) flush();
+    }
+
+    void InputRecorder::flush()
+    {
+        if (buffer.empty()) return;
+
+        {
+            std::scoped_lock lock{mutex};
+            pending.emplace_back(std::move(buffer));
+            if (spare.empty()) {
+                buffer = {};
+            } else {
+                buffer = std::move(spare.back());
+                spare.pop_back();
+            }
+        }
+        wake.notify_one();
+
+        buffer.reserve(RecorderFlushThreshold * 2);
+    }
+
+// -----------------------------------------------------------------------------
+
+    struct InputRecording::Impl : InputRecording
+    {
+        const std::byte* data = nullptr;
+        size_t size = 0;
+
+        std::string name;
+        uint32_t bustype, vendor, product, version;
+        std::vector<uint32_t> props;
+
+        struct Code
+        {
+            uint32_t type, code;
+            input_absinfo absinfo;
+            int value;
+        };
+        std::vector<Code> codes;
+
+        size_t events_begin = 0;
+        size_t cursor = 0;
+        int64_t last_time_us = 0;
+
+        ~Impl()
+        {
+            if (data) munmap(const_cast<std::byte*>(data), size);
+        }
+
+        uint64_t get_varint()
+        {
+            uint64_t v = 0;
+            for (uint32_t shift = 0; shift < 64; shift += 7) {
+                if (cursor >= size) raise_error("Recording truncated");
+                auto byte = uint8_t(data[cursor++]);
+                v |= uint64_t(byte & 0x7f) << shift;
+                if (!(byte & 0x80)) return v;
+            }
+            raise_error("Recording corrupt, varint overflow");
+        }
+
+        int64_t get_svarint()
+        {
+            return zigzag_decode(get_varint());
+        }
+    };
+
+    InputRecording* InputRecording::create(const char* path)
+    {
+        auto self = new InputRecording::Impl;
+        defer { unref(self); };
+
+        auto fd = unix_check_n1(open(path, O_RDONLY | O_CLOEXEC));
+        defer { close(fd); };
+
+        struct stat st;
+        unix_check_n1(fstat(fd, &st));
+        if (size_t(st.st_size) < RecordingMagic.size()) raise_error("Recording [{}] too small", path);
+
+        auto mapping = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping == MAP_FAILED) raise_unix_error("mmap");
+        self->data = static_cast<const std::byte*>(mapping);
+        self->size = st.st_size;
+        madvise(mapping, st.st_size, MADV_SEQUENTIAL);
+
+        // Header
+
+        if (std::memcmp(self->data, RecordingMagic.data(), RecordingMagic.size())) {
+            raise_error("[{}] is not a recording", path);
+        }
+        self->cursor = RecordingMagic.size();
+
+        if (auto version = self->get_varint(); version != RecordingVersion) {
+            raise_error("Recording [{}] has unsupported version {}", path, version);
+        }
+
+        auto name_size = self->get_varint();
+        if (self->cursor + name_size > self->size) raise_error("Recording truncated");
+        self->name.assign(reinterpret_cast<const char*>(self->data + self->cursor), name_size);
+        self->cursor += name_size;
+
+        self->bustype = uint32_t(self->get_varint());
+        self->vendor  = uint32_t(self->get_varint());
+        self->product = uint32_t(self->get_varint());
+        self->version = uint32_t(self->get_varint());
+
+        self->props.resize(self->get_varint());
+        for (auto& prop : self->props) prop = uint32_t(self->get_varint());
+
+        self->codes.resize(self->get_varint());
+        for (auto& code : self->codes) {
+            auto key = self->get_varint();
+            code.type = uint32_t(key >> RecordingCodeBits);
+            code.code = uint32_t(key & ((1 << RecordingCodeBits) - 1));
+            if (code.type == EV_ABS) {
+                code.absinfo.value      = int32_t(self->get_svarint());
+                code.absinfo.minimum    = int32_t(self->get_svarint());
+                code.absinfo.maximum    = int32_t(self->get_svarint());
+                code.absinfo.fuzz       = int32_t(self->get_svarint());
+                code.absinfo.flat       = int32_t(self->get_svarint());
+                code.absinfo.resolution = int32_t(self->get_svarint());
+            } else if (code.type == EV_REP) {
+                code.value = int32_t(self->get_svarint());
+            }
+        }
+
+        self->events_begin = self->cursor;
+
+        return take(self);
+    }
+
+    void InputRecording::destroy(InputRecording* _self)
+    {
+        delete get_impl(_self);
+    }
+
+    libevdev* InputRecording::create_device()
+    {
+        decl_self(this);
+
+        auto device = libevdev_new();
+        libevdev_set_name(device, self->name.c_str());
+        libevdev_set_id_bustype(device, self->bustype);
+        libevdev_set_id_vendor(device, self->vendor);
+        libevdev_set_id_product(device, self->product);
+        libevdev_set_id_version(device, self->version);
+
+        for (auto prop : self->props) libevdev_enable_property(device, prop);
+
+        for (auto& code : self->codes) {
+            const void* data = nullptr;
+            if      (code.type == EV_ABS) data = &code.absinfo;
+            else if (code.type == EV_REP) data = &code.value;
+            libevdev_enable_event_code(device, code.type, code.code, data);
+        }
+
+        return device;
+    }
+
+    bool InputRecording::next_event(input_event* event)
+    {
+        decl_self(this);
+
+        if (self->cursor >= self->size) return false;
+
+        auto time = self->last_time_us + self->get_svarint();
+        auto key = self->get_varint();
+        auto value = self->get_svarint();
+        self->last_time_us = time;
+
+        *event = input_event {
+            .time = from_us(time),
+            .type = uint16_t(key >> RecordingCodeBits),
+            .code = uint16_t(key & ((1 << RecordingCodeBits) - 1)),
+            .value = int32_t(value),
+        };
+
+        return true;
+    }
+
+    void InputRecording::rewind()
+    {
+        decl_self(this);
+
+        self->cursor = self->events_begin;
+        self->last_time_us = 0;
+    }
+
+// -----------------------------------------------------------------------------
+
+    struct InputReplay::Impl : InputReplay
+    {
+        FdEventBus* bus;
+        InputRecording* recording = nullptr;
+        InputReplayMode mode;
+
+        EvInputDevice* device = nullptr;
+        int write_fd = -1;
+
+        // Next frame to feed, with the number of its bytes already written to the pipe
+        std::vector<input_event> frame;
+        size_t frame_written = 0;
+        int64_t frame_time_us = 0;
+
+        std::chrono::steady_clock::time_point start;
+        std::optional<int64_t> first_time_us;
+
+        TimerHandle timer;
+        FdListenerHandle writable;
+
+        ~Impl()
+        {
+            bus->cancel(timer);
+            if (writable) bus->unregister_fd_listener(writable);
+            if (write_fd != -1) close(write_fd);
+            unref(recording);
+        }
+    };
+
+    namespace
+    {
+        bool read_replay_frame(InputReplay::Impl* self)
+        {
+            input_event ev;
+            while (self->recording->next_event(&ev)) {
+                if (self->frame.empty()) self->frame_time_us = to_us(ev.time);
+                self->frame.emplace_back(ev);
+                if (ev.type == EV_SYN && ev.code == SYN_REPORT) return true;
+            }
+
+            // Recording ended mid frame, terminate it so that the partial frame is still delivered
+            if (self->frame.empty()) return false;
+            self->frame.emplace_back(input_event{ .type = EV_SYN, .code = SYN_REPORT });
+            return true;
+        }
+
+        void pump_replay(InputReplay::Impl* self)
+        {
+            namespace chr = std::chrono;
+
+            for (;;) {
+                if (self->frame.empty()) {
+                    if (!read_replay_frame(self)) {
+                        // Closing the write end delivers end of file, which removes the device
+                        log_debug("Replay of [{}] complete", self->device->get_name());
+                        close(take_fd(self->write_fd));
+                        return;
+                    }
+                }
+
+                if (!self->frame_written) {
+                    if (self->mode == InputReplayMode::RealTime) {
+                        if (!self->first_time_us) self->first_time_us = self->frame_time_us;
+                        auto due = self->start + chr::microseconds(self->frame_time_us - *self->first_time_us);
+                        auto now = chr::steady_clock::now();
+                        if (due > now) {
+                            self->timer = self->bus->schedule_after(due - now, [self] { pump_replay(self); });
+                            return;
+                        }
+                    }
+
+                    auto time = now_monotonic();
+                    for (auto& ev : self->frame) ev.time = time;
+                }
+
+                auto bytes = std::as_bytes(std::span(self->frame)).subspan(self->frame_written);
+                auto written = write(self->write_fd, bytes.data(), bytes.size());
+                if (written < 0) {
+                    if (errno == EINTR) continue;
+                    if (errno != EAGAIN) raise_unix_error("write");
+
+                    // Pipe is full, resume once the device has consumed some input
+                    self->writable = self->bus->register_fd_listener(self->write_fd, EPOLLOUT, [self](FdEventData) {
+                        self->bus->unregister_fd_listener(std::exchange(self->writable, {}));
+                        pump_replay(self);
+                    });
+                    return;
+                }
+
+                self->frame_written += written;
+                if (self->frame_written == self->frame.size() * sizeof(input_event)) {
+                    self->frame.clear();
+                    self->frame_written = 0;
+                }
+            }
+        }
+    }
+
+    InputReplay* InputReplay::create(FdEventBus* bus, EvDevSubsystem* evdev, const char* path, InputReplayMode mode)
+    {
+        auto self = new InputReplay::Impl;
+        defer { unref(self); };
+
+        self->bus = bus;
+        self->mode = mode;
+        self->recording = InputRecording::create(path);
+
+        int fds[2];
+        unix_check_n1(pipe2(fds, O_CLOEXEC | O_NONBLOCK));
+        self->write_fd = fds[1];
+        self->device = evdev->add_synthetic_device(fds[0], self->recording->create_device());
+
+        log_info("Replaying [{}] from {} ({})", self->device->get_name(), path,
+            mode == InputReplayMode::RealTime ? "real time" : "as fast as possible");
+
+        // Frames are only read by the device once the bus runs, so callbacks registered after creation see everything
+        self->start = std::chrono::steady_clock::now();
+        pump_replay(self);
+
+        return take(self);
+    }
+
+    void InputReplay::destroy(InputReplay* _self)
+    {
+        delete get_impl(_self);
+    }
+
+    EvInputDevice* InputReplay::get_device()
+    {
+        return get_impl(this)->device;
+    }
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "evdev_subsystem.hpp"
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace input
+{
+    // Compact binary capture of a device's raw event stream.
+    //
+    //   header  magic "INREC", format version
+    //           name, bustype, vendor, product, version
+    //           properties, event codes (absinfo for EV_ABS)
+    //   events  zigzag(delta_us) (type << 10 | code) zigzag(value)
+    //
+    //   All integers are LEB128 varints, timestamps are deltas from the previous event. A typical event
+    //   takes 4-6 bytes instead of the 24 of a raw input_event.
+
+    struct InputRecorder
+    {
+        int fd = -1;
+        std::vector<std::byte> buffer;
+        int64_t last_time_us = 0;
+
+        // Full buffers are handed to a writer thread, so a slow disk never stalls the thread recording.
+        //   Written buffers are recycled to avoid reallocating.
+        std::mutex mutex;
+        std::condition_variable wake;
+        std::vector<std::vector<std::byte>> pending;
+        std::vector<std::vector<std::byte>> spare;
+        bool stopping = false;
+        std::jthread writer;
+
+        // Takes ownership of fd, the header describing the device capabilities is queued immediately
+        InputRecorder(int fd, libevdev* device);
+
+        // Waits for everything recorded to be written
+        ~InputRecorder();
+
+        InputRecorder(const InputRecorder&) = delete;
+        InputRecorder& operator=(const InputRecorder&) = delete;
+
+        void record(std::span<const input_event> frame);
+
+        // Queues the current buffer for writing without waiting for it
+        void flush();
+    };
+
+    // Read-only view of a recording, mapped into memory
+
+    struct InputRecording : RefCounted
+    {
+        struct Impl;
+
+        static InputRecording* create(const char* path);
+        static void destroy(InputRecording*);
+
+    public:
+        // Returns a new libevdev context with the recorded name, ids and capabilities
+        libevdev* create_device();
+
+        // Decodes the next event, returns false at end of recording
+        bool next_event(input_event* event);
+        void rewind();
+    };
+
+    enum class InputReplayMode
+    {
+        RealTime,   // Frames are spaced as recorded
+        AsFastAsPossible,
+    };
+
+    // Replays a recording through a synthetic device, driving the same callback pipeline as live input.
+    //   Events are restamped with CLOCK_MONOTONIC at the time they are fed in. The device is removed once
+    //   the recording has been fully replayed.
+
+    struct InputReplay : RefCounted
+    {
+        struct Impl;
+
+        static InputReplay* create(FdEventBus*, EvDevSubsystem*, const char* path, InputReplayMode mode);
+        static void destroy(InputReplay*);
+
+    public:
+        // The synthetic device, owned by the evdev subsystem. It is freed once its DeviceRemoved event has been
+        //   dispatched, which happens after the recording ends (or the replay is destroyed), so the pointer must
+        //   not be used past that event. Register a callback on the device to observe it.
+        EvInputDevice* get_device();
+    };
+}
@@ -0,0 +1,137 @@
+#include "key_remapper.hpp"
+
+namespace input
+{
+    KeyMacro& KeyMacro::press(uint16_t code)
+    {
+        events.emplace_back(input_event{ .type = EV_KEY, .code = code, .value = 1 });
+        events.emplace_back(input_event{ .type = EV_SYN, .code = SYN_REPORT });
+        return *this;
+    }
+
+    KeyMacro& KeyMacro::release(uint16_t code)
+    {
+        events.emplace_back(input_event{ .type = EV_KEY, .code = code, .value = 0 });
+        events.emplace_back(input_event{ .type = EV_SYN, .code = SYN_REPORT });
+        return *this;
+    }
+
+// -----------------------------------------------------------------------------
+
+    KeyRemapper::KeyRemapper()
+        : table(ModifierStates * KEY_CNT)
+    {}
+
+    uint8_t KeyRemapper::add_modifier(uint16_t key, uint16_t hold_key, uint16_t tap_key)
+    {
+        if (modifiers.size() >= MaxModifiers) raise_error("Too many modifiers (max {})", MaxModifiers);
+        if (key >= KEY_CNT) raise_error("Invalid modifier key {}", key);
+
+        auto index = uint16_t(modifiers.size());
+        modifiers.emplace_back(Modifier { key, hold_key, tap_key });
+
+        // Modifiers keep their meaning in every layer
+        for (uint32_t state = 0; state < ModifierStates; ++state) {
+            lookup(uint8_t(state), key) = Action { ActionType::Modifier, index };
+        }
+
+        return uint8_t(1 << index);
+    }
+
+    void KeyRemapper::map_key(KeyChord chord, uint16_t output)
+    {
+        if (chord.key >= KEY_CNT || chord.modifiers >= ModifierStates) raise_error("Invalid chord");
+        lookup(chord.modifiers, chord.key) = Action { ActionType::Remap, output };
+    }
+
+    void KeyRemapper::map_macro(KeyChord chord, const KeyMacro& macro)
+    {
+        if (chord.key >= KEY_CNT || chord.modifiers >= ModifierStates) raise_error("Invalid chord");
+
+        auto index = uint16_t(macros.size());
+        macros.emplace_back(MacroRange { uint32_t(macro_events.size()), uint32_t(macro.events.size()) });
+        macro_events.insert(macro_events.end(), macro.events.begin(), macro.events.end());
+        lookup(chord.modifiers, chord.key) = Action { ActionType::Macro, index };
+    }
+
+    void KeyRemapper::send_holds(UInputWriter& out)
+    {
+        auto pending = hold_pending & modifier_state;
+        hold_pending = 0;
+        if (!pending) return;
+
+        for (uint32_t i = 0; i < modifiers.size(); ++i) {
+            if (!(pending & (1 << i))) continue;
+            log_trace("Mapping (modifier {}) -> {}", i, libevdev_event_code_get_name(EV_KEY, modifiers[i].hold_key));
+            out.emit(EV_KEY, modifiers[i].hold_key, 1);
+            hold_active |= 1 << i;
+        }
+        out.sync();
+    }
+
+    void KeyRemapper::process(const input_event& ev, UInputWriter& out)
+    {
+        if (ev.type != EV_KEY || ev.code >= KEY_CNT) {
+            if (ev.type != EV_MSC || ev.code != MSC_SCAN) out.emit(ev.type, ev.code, ev.value);
+            return;
+        }
+
+        auto action = lookup(modifier_state, ev.code);
+
+        if (action.type == ActionType::Modifier) {
+            auto bit = uint8_t(1 << action.arg);
+            auto& modifier = modifiers[action.arg];
+            if (ev.value == 1) {
+                modifier_state |= bit;
+                used &= ~bit;
+                if (modifier.hold_key != KEY_RESERVED) hold_pending |= bit;
+            } else if (ev.value == 0) {
+                if (hold_active & bit) {
+                    out.emit(EV_KEY, modifier.hold_key, 0);
+                } else if (modifier.tap_key != KEY_RESERVED && !(used & bit)) {
+                    out.emit(EV_KEY, modifier.tap_key, 1);
+                    out.sync();
+                    out.emit(EV_KEY, modifier.tap_key, 0);
+                }
+                modifier_state &= ~bit;
+                hold_pending &= ~bit;
+                hold_active &= ~bit;
+            }
+            return;
+        }
+
+        auto& output = pressed_output[ev.code];
+
+        if (ev.value != 1) {
+            // Repeats and releases follow whatever the press was mapped to
+            if (output == NoOutput || output == Swallowed) {
+                if (!ev.value) output = NoOutput;
+                return;
+            }
+            out.emit(EV_KEY, output, ev.value);
+            if (!ev.value) output = NoOutput;
+            return;
+        }
+
+        used |= modifier_state;
+
+        switch (action.type) {
+            break;case ActionType::Macro: {
+                // Macros replace the modifier's hold behaviour
+                hold_pending &= ~modifier_state;
+                auto& macro = macros[action.arg];
+                log_trace("Mapping ({} + {}) -> macro {}", modifier_state, libevdev_event_code_get_name(EV_KEY, ev.code), action.arg);
+                out.append(std::span(macro_events).subspan(macro.offset, macro.count));
+                output = Swallowed;
+            }
+            break;case ActionType::Remap:
+                send_holds(out);
+                out.emit(EV_KEY, action.arg, 1);
+                output = action.arg;
+            break;default:
+                send_holds(out);
+                out.emit(EV_KEY, ev.code, 1);
+                output = ev.code;
+        }
+    }
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include "uinput_writer.hpp"
+
+#include <array>
+#include <vector>
+
+namespace input
+{
+    // Pre-encoded event sequence, each press or release is followed by a SYN_REPORT
+
+    struct KeyMacro
+    {
+        std::vector<input_event> events;
+
+        KeyMacro& press(uint16_t code);
+        KeyMacro& release(uint16_t code);
+        KeyMacro& tap(uint16_t code) { return press(code).release(code); }
+    };
+
+    // Modifier state (a bitmask of modifier indices, see KeyRemapper::add_modifier) plus a key
+    struct KeyChord
+    {
+        uint8_t modifiers;
+        uint16_t key;
+    };
+
+    // Compiles remapping rules into a dense table indexed by (modifier state, key code), so handling an
+    //   event is a single lookup regardless of how many rules are configured. Events other than EV_KEY
+    //   pass through (MSC_SCAN is dropped, as scan codes no longer match remapped keys).
+    //
+    //   Modifiers are tap/hold keys that select a layer. While held with an unmapped key they emit their
+    //   hold key (e.g. F13 acting as Alt), released on their own they emit their tap key.
+
+    struct KeyRemapper
+    {
+        static constexpr uint32_t MaxModifiers = 4;
+        static constexpr uint32_t ModifierStates = 1 << MaxModifiers;
+
+        enum class ActionType : uint8_t
+        {
+            PassThrough,
+            Remap,
+            Macro,
+            Modifier,
+        };
+
+        struct Action
+        {
+            ActionType type = ActionType::PassThrough;
+            uint16_t arg = 0;
+        };
+
+        struct Modifier
+        {
+            uint16_t key;
+            uint16_t hold_key; // KEY_RESERVED for none
+            uint16_t tap_key;  // KEY_RESERVED for none
+        };
+
+        struct MacroRange
+        {
+            uint32_t offset;
+            uint32_t count;
+        };
+
+        static constexpr uint16_t NoOutput = KEY_RESERVED;
+        static constexpr uint16_t Swallowed = UINT16_MAX;
+
+        std::vector<Action> table;
+        std::vector<Modifier> modifiers;
+        std::vector<input_event> macro_events;
+        std::vector<MacroRange> macros;
+
+        uint8_t modifier_state = 0;
+        uint8_t hold_pending = 0; // Held modifiers whose hold key has not been sent yet
+        uint8_t hold_active = 0;
+        uint8_t used = 0;         // Held modifiers that have been combined with another key, suppressing taps
+
+        // Output key for each held input key, so releases match presses even if modifiers changed in between
+        std::array<uint16_t, KEY_CNT> pressed_output = {};
+
+        KeyRemapper();
+
+        // Returns the modifier's bit for use in chords
+        uint8_t add_modifier(uint16_t key, uint16_t hold_key = KEY_RESERVED, uint16_t tap_key = KEY_RESERVED);
+
+        void map_key(KeyChord chord, uint16_t output);
+        void map_macro(KeyChord chord, const KeyMacro& macro);
+
+        void process(const input_event& ev, UInputWriter& out);
+
+    private:
+        Action& lookup(uint8_t modifiers, uint16_t key) { return table[modifiers * KEY_CNT + key]; }
+        void send_holds(UInputWriter& out);
+    };
+}
@@ -0,0 +1,57 @@
+#include "latency_histogram.hpp"
+
+#include <cmath>
+
+#include <time.h>
+
+namespace input
+{
+    uint64_t LatencyHistogram::percentile(double p) const
+    {
+        if (!total) return 0;
+
+        auto target = std::max<uint64_t>(1, uint64_t(std::ceil(p / 100.0 * double(total))));
+        uint64_t seen = 0;
+        for (uint32_t i = 0; i < BucketCount; ++i) {
+            seen += counts[i];
+            if (seen >= target) return std::min(bucket_value(i), max);
+        }
+        return max;
+    }
+
+    namespace
+    {
+        struct PendingFrame
+        {
+            LatencyHistogram* histogram = nullptr;
+            timeval source_time;
+        };
+
+        thread_local PendingFrame pending_frame;
+    }
+
+    void latency_begin_frame(LatencyHistogram* histogram, const timeval& source_time)
+    {
+        pending_frame = { histogram, source_time };
+    }
+
+    void latency_end_frame()
+    {
+        pending_frame.histogram = nullptr;
+    }
+
+    void latency_record_forwarded()
+    {
+        if (!pending_frame.histogram) return;
+
+        timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+
+        auto now_ns = int64_t(now.tv_sec) * 1'000'000'000 + now.tv_nsec;
+        auto source_ns = int64_t(pending_frame.source_time.tv_sec) * 1'000'000'000 + int64_t(pending_frame.source_time.tv_usec) * 1'000;
+        pending_frame.histogram->record(uint64_t(std::max<int64_t>(0, now_ns - source_ns)));
+
+        // Only the first write for a frame counts
+        pending_frame.histogram = nullptr;
+    }
+}
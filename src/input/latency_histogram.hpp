@@ -0,0 +1,67 @@
+#pragma once
+
+#include "core.hpp"
+
+#include <array>
+#include <bit>
+
+#include <sys/time.h>
+
+namespace input
+{
+    // Log-linear (HDR-style) histogram of nanosecond durations. Each power of two is split into
+    //   SubBuckets linear buckets, giving a constant ~3% relative precision over the full range.
+
+    struct LatencyHistogram
+    {
+        static constexpr uint32_t SubBucketBits = 5;
+        static constexpr uint32_t SubBuckets = 1 << SubBucketBits;
+        static constexpr uint32_t BucketCount = (65 - SubBucketBits) * SubBuckets;
+
+        std::array<uint64_t, BucketCount> counts = {};
+        uint64_t total = 0;
+        uint64_t min = UINT64_MAX;
+        uint64_t max = 0;
+        uint64_t sum = 0;
+
+        static constexpr uint32_t bucket_index(uint64_t ns)
+        {
+            uint32_t shift = std::max(0, int(std::bit_width(ns)) - int(SubBucketBits + 1));
+            return shift * SubBuckets + uint32_t(ns >> shift);
+        }
+
+        // Highest value that maps to the given bucket
+        static constexpr uint64_t bucket_value(uint32_t index)
+        {
+            if (index < SubBuckets * 2) return index;
+            uint32_t shift = index / SubBuckets - 1;
+            uint64_t sub = index % SubBuckets + SubBuckets;
+            return ((sub + 1) << shift) - 1;
+        }
+
+        void record(uint64_t ns)
+        {
+            counts[bucket_index(ns)]++;
+            total++;
+            sum += ns;
+            min = std::min(min, ns);
+            max = std::max(max, ns);
+        }
+
+        void reset()
+        {
+            *this = {};
+        }
+
+        // Percentile in [0, 100]
+        uint64_t percentile(double p) const;
+    };
+
+    // Forward latency is measured from the kernel timestamp of the source frame to the completion of the
+    //   output write. Input sources open a frame while dispatching it, and output writers record the
+    //   latency against it on the first write that completes. Timestamps must be CLOCK_MONOTONIC.
+
+    void latency_begin_frame(LatencyHistogram* histogram, const timeval& source_time);
+    void latency_end_frame();
+    void latency_record_forwarded();
+}
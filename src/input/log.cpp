@@ -0,0 +1,238 @@
+#include "log.hpp"
+
+#include "spsc_queue.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace input::log_detail
+{
+    namespace
+    {
+        constexpr uint32_t LogBufferSize = 64 * 1024;
+
+        // Largest record accepted, so that a record always fits after padding out the end of the ring
+        constexpr uint32_t MaxRecordSize = LogBufferSize / 2;
+
+        struct LogBuffer
+        {
+            SpscQueue<std::byte> queue{LogBufferSize};
+            std::atomic<uint64_t> dropped = 0;
+            std::atomic<bool> closed = false; // Owning thread has exited
+        };
+
+        // Once the logger has been torn down (static destruction), records are formatted in place
+        std::atomic<bool> logger_shutdown = false;
+
+        // Set by producers to wake the drain thread, which blocks on it whenever every ring is empty
+        std::atomic<bool> drain_wake = false;
+
+        void wake_drain_thread()
+        {
+            drain_wake.store(true, std::memory_order_relaxed);
+            drain_wake.notify_one();
+        }
+
+        void format_record(const std::byte* record, std::string& out)
+        {
+            RecordHeader header;
+            std::memcpy(&header, record, sizeof(header));
+
+            switch (header.level) {
+                break;case LogLevel::Trace: out += "[" text_ansi_color(90, "TRACE") "] \u001B[90m";
+                break;case LogLevel::Debug: out += "[" text_ansi_color(96, "DEBUG") "] ";
+                break;case LogLevel::Info:  out += " [" text_ansi_color(94, "INFO") "] ";
+                break;case LogLevel::Warn:  out += " [" text_ansi_color(93, "WARN") "] ";
+                break;case LogLevel::Error: out += "[" text_ansi_color(91, "ERROR") "] ";
+            }
+
+            try {
+                header.decode(out, std::string_view(header.fmt, header.fmt_size), record + sizeof(header));
+            } catch (const std::exception& e) {
+                out += std::format("<format error: {}>", e.what());
+            }
+
+            if (header.level == LogLevel::Trace) out += "\u001B[0m";
+            out += '\n';
+        }
+
+        void write_out(std::string& out)
+        {
+            if (out.empty()) return;
+            std::fwrite(out.data(), 1, out.size(), stdout);
+            std::fflush(stdout);
+            out.clear();
+        }
+
+        struct Logger
+        {
+            std::mutex buffers_mutex;
+            std::vector<std::unique_ptr<LogBuffer>> buffers;
+
+            // Serializes consumers, the background thread and any explicit flushes
+            std::mutex drain_mutex;
+            std::vector<LogBuffer*> drain_buffers;
+            std::string output;
+
+            std::jthread thread;
+
+            Logger()
+            {
+                output.reserve(LogBufferSize);
+                thread = std::jthread([this](std::stop_token stop) {
+                    while (!stop.stop_requested()) {
+                        // Clear before draining, the fence pairs with commit_record so that a record committed
+                        //   concurrently is either seen by this drain or sets the flag again
+                        drain_wake.store(false, std::memory_order_relaxed);
+                        std::atomic_thread_fence(std::memory_order_seq_cst);
+                        if (!drain()) drain_wake.wait(false, std::memory_order_relaxed);
+                    }
+                });
+            }
+
+            ~Logger()
+            {
+                logger_shutdown = true;
+                thread.request_stop();
+                wake_drain_thread();
+                thread.join();
+                drain();
+            }
+
+            LogBuffer* register_buffer()
+            {
+                std::scoped_lock lock{buffers_mutex};
+                return buffers.emplace_back(std::make_unique<LogBuffer>()).get();
+            }
+
+            bool drain()
+            {
+                std::scoped_lock lock{drain_mutex};
+
+                {
+                    // Buffers of exited threads are freed once fully consumed
+
+                    std::scoped_lock buffers_lock{buffers_mutex};
+                    std::erase_if(buffers, [](auto& buffer) {
+                        return buffer->closed.load(std::memory_order_acquire) && buffer->queue.empty();
+                    });
+                    drain_buffers.clear();
+                    for (auto& buffer : buffers) drain_buffers.emplace_back(buffer.get());
+                }
+
+                bool any = false;
+                for (auto buffer : drain_buffers) {
+                    if (auto dropped = buffer->dropped.exchange(0, std::memory_order_relaxed)) {
+                        output += std::format(" [" text_ansi_color(93, "WARN") "] {} log messages dropped\n", dropped);
+                    }
+
+                    for (;;) {
+                        auto span = buffer->queue.prepare_read();
+                        if (span.empty()) break;
+                        any = true;
+
+                        // Records never straddle the wrap point, so every readable span holds whole records
+                        for (size_t pos = 0; pos < span.size();) {
+                            uint32_t size;
+                            bool padding;
+                            std::memcpy(&size, span.data() + pos + offsetof(RecordHeader, size), sizeof(size));
+                            std::memcpy(&padding, span.data() + pos + offsetof(RecordHeader, padding), sizeof(padding));
+                            if (!padding) format_record(span.data() + pos, output);
+                            pos += size;
+                        }
+                        buffer->queue.commit_read(uint32_t(span.size()));
+                    }
+                }
+
+                write_out(output);
+                return any;
+            }
+        };
+
+        Logger& get_logger()
+        {
+            static Logger logger;
+            return logger;
+        }
+
+        struct LogThreadBuffer
+        {
+            LogBuffer* buffer = nullptr;
+
+            ~LogThreadBuffer()
+            {
+                if (buffer) buffer->closed.store(true, std::memory_order_release);
+            }
+        };
+
+        thread_local LogThreadBuffer thread_buffer;
+        thread_local std::vector<std::byte> shutdown_scratch;
+    }
+
+    std::byte* begin_record(uint32_t size)
+    {
+        if (logger_shutdown.load(std::memory_order_acquire)) {
+            shutdown_scratch.resize(size);
+            return shutdown_scratch.data();
+        }
+
+        auto& local = thread_buffer;
+        if (!local.buffer) local.buffer = get_logger().register_buffer();
+        auto buffer = local.buffer;
+        auto& queue = buffer->queue;
+
+        if (size > MaxRecordSize) {
+            buffer->dropped.fetch_add(1, std::memory_order_relaxed);
+            return nullptr;
+        }
+
+        auto span = queue.prepare_write();
+        if (span.size() < size) {
+            // If only limited by the wrap point, pad out the end of the ring and retry from the start
+
+            auto to_end = queue.capacity - (queue.tail.load(std::memory_order_relaxed) & (queue.capacity - 1));
+            if (span.size() == to_end) {
+                RecordHeader padding { .size = to_end, .padding = true };
+                std::memcpy(span.data(), &padding, std::min<size_t>(sizeof(padding), to_end));
+                queue.commit_write(to_end);
+                span = queue.prepare_write();
+            }
+
+            if (span.size() < size) {
+                buffer->dropped.fetch_add(1, std::memory_order_relaxed);
+                return nullptr;
+            }
+        }
+
+        return span.data();
+    }
+
+    void commit_record(uint32_t size)
+    {
+        if (logger_shutdown.load(std::memory_order_acquire)) {
+            std::string out;
+            format_record(shutdown_scratch.data(), out);
+            write_out(out);
+            return;
+        }
+
+        thread_buffer.buffer->queue.commit_write(size);
+
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (!drain_wake.load(std::memory_order_relaxed)) wake_drain_thread();
+    }
+}
+
+namespace input
+{
+    void log_flush()
+    {
+        if (log_detail::logger_shutdown.load(std::memory_order_acquire)) return;
+        log_detail::get_logger().drain();
+    }
+}
@@ -0,0 +1,183 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <format>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+
+// Lowest level compiled in, calls below it are removed entirely and don't evaluate their arguments. 0 = trace ... 4 = error
+#ifndef INPUT_LOG_LEVEL
+#define INPUT_LOG_LEVEL 0
+#endif
+
+namespace input
+{
+    enum class LogLevel : uint8_t
+    {
+        Trace,
+        Debug,
+        Info,
+        Warn,
+        Error,
+    };
+
+    constexpr auto CompiledLogLevel = LogLevel(INPUT_LOG_LEVEL);
+
+    // Asynchronous logging.
+    //   Each logging thread owns a lock-free SPSC ring. A call copies the format string pointer and its
+    //   arguments into the ring (strings by value, trivially copyable values raw) and returns. Formatting
+    //   and output happen on a background thread. Messages with any other argument type are formatted
+    //   in full on the calling thread instead, so every argument keeps its format spec. If a ring is
+    //   full the message is dropped and counted, the logging thread never blocks.
+
+    // Formats and writes out everything logged so far, from the calling thread
+    void log_flush();
+
+    namespace log_detail
+    {
+        using DecodeFn = void(*)(std::string& out, std::string_view fmt, const std::byte* args);
+
+        struct RecordHeader
+        {
+            uint32_t size; // Including header and padding
+            LogLevel level;
+            bool padding;
+            DecodeFn decode;
+            const char* fmt;
+            size_t fmt_size;
+        };
+
+        constexpr uint32_t RecordAlign = 8;
+
+        // Reserves space for a record in the calling thread's ring, nullptr if full
+        std::byte* begin_record(uint32_t size);
+        void commit_record(uint32_t size);
+
+        template<typename T>
+        constexpr bool is_string_like = std::is_convertible_v<const T&, std::string_view>;
+
+        template<typename T>
+        constexpr bool is_raw = !is_string_like<T> && std::is_trivially_copyable_v<T>;
+
+        // Arguments that can't be captured as-is, which makes the whole message format on the calling thread
+        template<typename T>
+        constexpr bool is_deferred = is_string_like<T> || is_raw<T>;
+
+        // Representation captured on the logging thread, which is also the type handed to the formatter
+
+        template<typename T>
+        using stored_t = std::conditional_t<is_raw<T>, T, std::string_view>;
+
+        template<typename T>
+        auto prepare(const T& value) -> stored_t<T>
+        {
+            if constexpr (std::is_convertible_v<const T&, const char*>) {
+                const char* str = value;
+                return std::string_view(str ? str : "(null)");
+            } else if constexpr (is_string_like<T>) {
+                return std::string_view(value);
+            } else {
+                return value;
+            }
+        }
+
+        // Strings are stored as a 32-bit length followed by the characters
+
+        template<typename T>
+        constexpr bool is_string = std::is_same_v<T, std::string_view>;
+
+        template<typename T>
+        uint32_t encoded_size(const T& value)
+        {
+            if constexpr (is_string<T>) return uint32_t(sizeof(uint32_t) + value.size());
+            else return sizeof(T);
+        }
+
+        template<typename T>
+        std::byte* encode(std::byte* out, const T& value)
+        {
+            if constexpr (is_string<T>) {
+                auto size = uint32_t(value.size());
+                std::memcpy(out, &size, sizeof(size));
+                std::memcpy(out + sizeof(size), value.data(), size);
+                return out + sizeof(size) + size;
+            } else {
+                std::memcpy(out, &value, sizeof(T));
+                return out + sizeof(T);
+            }
+        }
+
+        template<typename T>
+        T decode(const std::byte*& in)
+        {
+            if constexpr (std::is_same_v<T, std::string_view>) {
+                uint32_t size;
+                std::memcpy(&size, in, sizeof(size));
+                T value(reinterpret_cast<const char*>(in + sizeof(size)), size);
+                in += sizeof(size) + size;
+                return value;
+            } else {
+                T value;
+                std::memcpy(&value, in, sizeof(T));
+                in += sizeof(T);
+                return value;
+            }
+        }
+
+        template<typename ...Stored>
+        void decode_and_format(std::string& out, std::string_view fmt, const std::byte* in)
+        {
+            // Braced initialization evaluates left to right
+            std::tuple<Stored...> values { decode<Stored>(in)... };
+            std::apply([&](auto&... v) {
+                std::vformat_to(std::back_inserter(out), fmt, std::make_format_args(v...));
+            }, values);
+        }
+
+        // fmt must have static storage duration, only the pointer is recorded
+        template<LogLevel Level, typename ...Stored>
+        void write_record(std::string_view fmt, const Stored&... values)
+        {
+            uint32_t size = sizeof(RecordHeader);
+            ((size += encoded_size(values)), ...);
+            size = (size + RecordAlign - 1) & ~(RecordAlign - 1);
+
+            auto record = begin_record(size);
+            if (!record) return;
+
+            RecordHeader header {
+                .size = size,
+                .level = Level,
+                .padding = false,
+                .decode = &decode_and_format<Stored...>,
+                .fmt = fmt.data(),
+                .fmt_size = fmt.size(),
+            };
+            std::memcpy(record, &header, sizeof(header));
+
+            auto out = record + sizeof(header);
+            ((out = encode(out, values)), ...);
+
+            commit_record(size);
+        }
+    }
+
+    // Prefer the log_* macros in core.hpp, which skip evaluating arguments for levels that are compiled out
+    template<LogLevel Level, typename ...Args>
+    void log_write(std::format_string<Args...> fmt, Args&&... args)
+    {
+        if constexpr (Level >= CompiledLogLevel) {
+            using namespace log_detail;
+
+            if constexpr ((is_deferred<std::remove_cvref_t<Args>> && ...)) {
+                write_record<Level>(fmt.get(), prepare(args)...);
+            } else {
+                auto message = std::vformat(fmt.get(), std::make_format_args(args...));
+                write_record<Level>("{}", std::string_view(message));
+            }
+        }
+    }
+}
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <cmath>
+#include <algorithm>
+#include <limits>
 
 namespace input
 {
@@ -53,4 +55,55 @@ namespace input
 
     constexpr auto clamp(double v, double l, double h) { return v <= l ? l : v >= h ? h : v; }
     constexpr auto clamp(vec2   v, vec2   l, vec2   h) { return vec2(clamp(v.x, l.x, h.x), clamp(v.y, l.y, h.y)); }
+
+// -----------------------------------------------------------------------------
+
+    inline
+    auto maprange(double v, double in_low, double in_high, double out_low, double out_high, bool clamp = false) -> double
+    {
+        if (clamp) {
+            if (v < in_low) return out_low;
+            if (v > in_high) return out_high;
+        }
+        auto p = (v - in_low) / (in_high - in_low);
+        return p * (out_high - out_low) + out_low;
+    };
+
+    inline
+    auto deadzone(double v, double inner, double outer) -> double
+    {
+        if (std::abs(v) < inner) return 0;
+        return std::copysign(std::min((std::abs(v) - inner) / (1.0 - inner - outer), 1.0), v);
+    };
+
+    inline
+    auto deadzone_radial(vec2 pos, double inner, double outer) -> vec2
+    {
+        auto r = mag(pos);
+        if (r < inner) return vec2(0.0);
+
+        auto d = deadzone(r, inner, outer);
+
+        // Bump deadzone output, otherwise value flickers between 1.0 and 0.9999...
+        //   due to floating point precision limitations, which leads to rounding issues
+        d = std::nextafter(d, std::numeric_limits<double>::infinity());
+
+        return pos * (d / r);
+    };
+
+    inline
+    auto gamma(double v, double g) -> double
+    {
+        return std::copysign(std::pow(std::abs(v), g), v);
+    };
+
+    inline
+    auto radial_to_wheel(vec2 pos, double q_max, double r_gamma, double q_gamma) -> double
+    {
+        auto r = gamma(mag(pos), r_gamma);
+        auto q = std::atan2(pos.x, pos.y) / q_max;
+        q = std::clamp(q, -1.0, 1.0);
+        q = gamma(q, q_gamma);
+        return std::clamp(std::min(r, 1.0) * q, -1.0, 1.0);
+    };
 }
@@ -0,0 +1,54 @@
+#include "mouse_motion.hpp"
+
+#include <cmath>
+
+namespace input
+{
+    void MouseMotion::configure(const MouseAccel& _accel)
+    {
+        accel = _accel;
+        for (uint32_t i = 0; i < SensTableSize; ++i) {
+            sens_table[i] = int32_t(std::lround(accel.sensitivity(std::sqrt(double(i))) * One));
+        }
+    }
+
+    namespace
+    {
+        int64_t sensitivity(const MouseMotion& self, uint64_t speed_squared)
+        {
+            if (speed_squared < MouseMotion::SensTableSize) [[likely]] return self.sens_table[speed_squared];
+            return std::llround(self.accel.sensitivity(std::sqrt(double(speed_squared))) * MouseMotion::One);
+        }
+    }
+
+    void MouseMotion::add(int32_t dx, int32_t dy)
+    {
+        if (!dx && !dy) return;
+
+        auto sx = int64_t(dx) * dx;
+        auto sy = int64_t(dy) * dy;
+
+        if (accel.mode == MouseAccelMode::Whole) {
+            auto sens = sensitivity(*this, uint64_t(sx + sy));
+            x += dx * sens;
+            y += dy * sens;
+        } else {
+            x += dx * sensitivity(*this, uint64_t(sx));
+            y += dy * sensitivity(*this, uint64_t(sy));
+        }
+    }
+
+    bool MouseMotion::take(int32_t* out_x, int32_t* out_y)
+    {
+        // Integer division truncates towards zero, leaving a remainder with the same sign as the motion
+        auto whole_x = x / One;
+        auto whole_y = y / One;
+        if (!whole_x && !whole_y) return false;
+
+        x -= whole_x * One;
+        y -= whole_y * One;
+        *out_x = int32_t(whole_x);
+        *out_y = int32_t(whole_y);
+        return true;
+    }
+}
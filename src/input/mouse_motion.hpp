@@ -0,0 +1,73 @@
+#pragma once
+
+#include "core.hpp"
+
+#include <algorithm>
+#include <array>
+
+namespace input
+{
+    // Linear acceleration curve
+    //
+    //   Offset - speed (counts per report) before acceleration is applied
+    //   Accel  - rate that sensitivity increases with speed
+    //   Mult   - total multiplier for sensitivity
+    //
+    //      /
+    //     / <- Accel
+    // ___/
+    //  ^-- Offset
+
+    enum class MouseAccelMode
+    {
+        ComponentWise, // Each axis accelerated by its own speed
+        Whole,         // Both axes accelerated by the combined speed
+    };
+
+    struct MouseAccel
+    {
+        MouseAccelMode mode = MouseAccelMode::Whole;
+        double offset = 2.0;
+        double accel = 0.05;
+        double mult = 1.0;
+
+        double sensitivity(double speed) const
+        {
+            return mult * (1 + (std::max(speed, offset) - offset) * accel);
+        }
+    };
+
+    // Accumulates accelerated relative motion in 48.16 fixed point, carrying the sub-count remainder between
+    //   outputs. Sensitivity is looked up by squared speed, so high polling rate mice (which report small
+    //   deltas very often) never touch floating point or sqrt per report.
+
+    struct MouseMotion
+    {
+        static constexpr uint32_t FractionBits = 16;
+        static constexpr int64_t One = int64_t(1) << FractionBits;
+
+        // Squared speeds below this use the table, above it sensitivity is computed directly
+        static constexpr uint32_t SensTableSize = 4096;
+
+        MouseAccel accel;
+        std::array<int32_t, SensTableSize> sens_table = {}; // Fixed point sensitivity by squared speed
+
+        // Pending motion, including the remainder
+        int64_t x = 0;
+        int64_t y = 0;
+
+        MouseMotion() { configure({}); }
+
+        void configure(const MouseAccel& accel);
+
+        // Adds one input report's worth of motion
+        void add(int32_t dx, int32_t dy);
+
+        // Removes and returns the whole counts accumulated so far (rounded towards zero), or false if none
+        bool take(int32_t* out_x, int32_t* out_y);
+
+        // Remainder in counts, for diagnostics
+        double remainder_x() const { return double(x) / One; }
+        double remainder_y() const { return double(y) / One; }
+    };
+}
@@ -0,0 +1,265 @@
+#include "pipeline.hpp"
+
+#include "math.hpp"
+#include "mouse_motion.hpp"
+
+#include <chrono>
+
+namespace input
+{
+    namespace
+    {
+        bool is_vectorized(PipelineStageType type)
+        {
+            return type == PipelineStageType::Deadzone
+                || type == PipelineStageType::DeadzoneRadial
+                || type == PipelineStageType::Gamma;
+        }
+
+        // Channels used by a vectorized stage, 2 for radial stages (x, y) and 1 otherwise
+        uint32_t lane_arity(PipelineStageType type)
+        {
+            return type == PipelineStageType::DeadzoneRadial ? 2 : 1;
+        }
+
+        bool joins_batch(const Pipeline& self, const PipelineBatch& batch, const PipelineStage& stage)
+        {
+            if (!is_vectorized(stage.type) || batch.type != stage.type) return false;
+
+            // All lanes are gathered before any are written, so a stage can't consume an output from its own batch
+            auto arity = lane_arity(stage.type);
+            for (uint32_t i = batch.first; i < batch.first + batch.count; ++i) {
+                for (uint32_t o = 0; o < arity; ++o) {
+                    for (uint32_t n = 0; n < arity; ++n) {
+                        if (self.stages[i].out[o] == stage.in[n]) return false;
+                    }
+                }
+            }
+            return true;
+        }
+
+        void batch_stage(Pipeline& self, uint32_t index)
+        {
+            auto& stage = self.stages[index];
+            if (self.batches.empty() || !joins_batch(self, self.batches.back(), stage)) {
+                self.batches.emplace_back(PipelineBatch { .type = stage.type, .first = index });
+                if (!self.stage_times.empty()) self.stage_times.emplace_back();
+            }
+
+            auto& batch = self.batches.back();
+            auto lane = batch.count++;
+            if (!is_vectorized(stage.type)) return;
+
+            // Padding lanes get neutral parameters, so they never produce errors or denormals
+            auto lanes = axis_padded(batch.count);
+            batch.x.resize(lanes);
+            batch.y.resize(lanes);
+            batch.p0.resize(lanes, stage.type == PipelineStageType::Gamma ? 1.f : 0.f);
+            batch.p1.resize(lanes);
+            batch.p0[lane] = stage.params[0];
+            batch.p1[lane] = stage.params[1];
+        }
+    }
+
+    uint32_t Pipeline::channel(std::string_view name)
+    {
+        auto existing = std::ranges::find(channel_names, name);
+        if (existing != channel_names.end()) return uint32_t(existing - channel_names.begin());
+
+        channel_names.emplace_back(name);
+        channels.emplace_back(0.f);
+        return uint32_t(channels.size() - 1);
+    }
+
+    Pipeline& Pipeline::source(uint16_t type, uint16_t code, std::string_view name)
+    {
+        if (type != EV_ABS && type != EV_KEY && type != EV_REL) raise_error("Unsupported pipeline source type {}", type);
+        sources.emplace_back(Source { type, code, channel(name) });
+        return *this;
+    }
+
+    Pipeline& Pipeline::stage(PipelineStageType type, std::initializer_list<std::string_view> in, std::initializer_list<std::string_view> out, std::initializer_list<float> params)
+    {
+        PipelineStage stage { .type = type };
+        if (in.size() > stage.in.size() || out.size() > stage.out.size() || params.size() > stage.params.size()) {
+            raise_error("Too many pipeline stage arguments");
+        }
+
+        // Channels are resolved once here, stages only ever see indices
+        uint32_t i = 0;
+        for (auto name : in) stage.in[i++] = channel(name);
+        i = 0;
+        for (auto name : out) stage.out[i++] = channel(name);
+        std::ranges::copy(params, stage.params.begin());
+
+        stages.emplace_back(stage);
+        batch_stage(*this, uint32_t(stages.size() - 1));
+        return *this;
+    }
+
+    Pipeline& Pipeline::sink(uint16_t type, uint16_t code, std::string_view name, float scale, std::optional<int32_t> rest)
+    {
+        if (type != EV_ABS && type != EV_KEY && type != EV_REL) raise_error("Unsupported pipeline sink type {}", type);
+        if (rest && type != EV_ABS) raise_error("Rest values are only supported by EV_ABS sinks");
+        sinks.emplace_back(Sink { type, code, channel(name), scale, rest });
+
+        if (type == EV_ABS) {
+            auto lane = size_t(std::ranges::count(sinks, uint16_t(EV_ABS), &Sink::type) - 1);
+            for (auto values : { &abs_values, &abs_low, &abs_high }) values->resize(axis_padded(lane + 1));
+            abs_out.resize(axis_padded(lane + 1));
+            abs_low[lane] = -scale;
+            abs_high[lane] = scale;
+        }
+        return *this;
+    }
+
+    void Pipeline::set_profiling(bool enabled)
+    {
+        stage_times.clear();
+        if (enabled) stage_times.resize(batches.size());
+    }
+
+    void Pipeline::run_stage(const PipelineStage& stage)
+    {
+        auto ch = channels.data();
+        auto& in = stage.in;
+        auto& out = stage.out;
+        auto& p = stage.params;
+
+        switch (stage.type) {
+            break;case PipelineStageType::MapRange:
+                ch[out[0]] = float(maprange(ch[in[0]], p[0], p[1], p[2], p[3], p[4] != 0));
+            break;case PipelineStageType::Deadzone:
+                ch[out[0]] = float(deadzone(ch[in[0]], p[0], p[1]));
+            break;case PipelineStageType::DeadzoneRadial: {
+                auto v = deadzone_radial(vec2(ch[in[0]], ch[in[1]]), p[0], p[1]);
+                ch[out[0]] = float(v.x);
+                ch[out[1]] = float(v.y);
+            }
+            break;case PipelineStageType::Gamma:
+                ch[out[0]] = float(gamma(ch[in[0]], p[0]));
+            break;case PipelineStageType::RadialToWheel:
+                ch[out[0]] = float(radial_to_wheel(vec2(ch[in[0]], ch[in[1]]), p[0], p[1], p[2]));
+            break;case PipelineStageType::Accel: {
+                auto delta = vec2(ch[in[0]], ch[in[1]]);
+                auto sens = MouseAccel { .offset = p[0], .accel = p[1], .mult = p[2] }.sensitivity(mag(delta));
+                ch[out[0]] = float(delta.x * sens);
+                ch[out[1]] = float(delta.y * sens);
+            }
+            break;case PipelineStageType::Add:
+                ch[out[0]] = ch[in[0]] + ch[in[1]];
+            break;case PipelineStageType::Above:
+                ch[out[0]] = ch[in[0]] > p[0] ? 1.f : 0.f;
+            break;case PipelineStageType::Below:
+                ch[out[0]] = ch[in[0]] < p[0] ? 1.f : 0.f;
+        }
+    }
+
+    void Pipeline::run_batch(PipelineBatch& batch)
+    {
+        if (batch.x.empty()) {
+            run_stage(stages[batch.first]);
+            return;
+        }
+
+        auto ch = channels.data();
+        auto radial = lane_arity(batch.type) == 2;
+
+        for (uint32_t lane = 0; lane < batch.count; ++lane) {
+            auto& stage = stages[batch.first + lane];
+            batch.x[lane] = ch[stage.in[0]];
+            if (radial) batch.y[lane] = ch[stage.in[1]];
+        }
+
+        switch (batch.type) {
+            break;case PipelineStageType::Deadzone:       axes_deadzone(batch.x, batch.p0, batch.p1);
+            break;case PipelineStageType::DeadzoneRadial: axes_deadzone_radial(batch.x, batch.y, batch.p0, batch.p1);
+            break;case PipelineStageType::Gamma:          axes_gamma(batch.x, batch.p0);
+            break;default:
+                std::unreachable();
+        }
+
+        for (uint32_t lane = 0; lane < batch.count; ++lane) {
+            auto& stage = stages[batch.first + lane];
+            ch[stage.out[0]] = batch.x[lane];
+            if (radial) ch[stage.out[1]] = batch.y[lane];
+        }
+    }
+
+    void Pipeline::process(const EvDevState& device)
+    {
+        for (auto& source : sources) {
+            auto& value = channels[source.channel];
+            switch (source.type) {
+                break;case EV_ABS: value = device.abs[source.code];
+                break;case EV_KEY: value = device.keys.test(source.code) ? 1.f : 0.f;
+                break;case EV_REL: value = float(device.rel[source.code]);
+            }
+        }
+
+        if (stage_times.empty()) {
+            for (auto& batch : batches) run_batch(batch);
+        } else {
+            for (uint32_t i = 0; i < batches.size(); ++i) {
+                auto start = std::chrono::steady_clock::now();
+                run_batch(batches[i]);
+                stage_times[i].record(uint64_t(std::chrono::nanoseconds(std::chrono::steady_clock::now() - start).count()));
+            }
+        }
+
+        uint32_t abs_lane = 0;
+        for (auto& sink : sinks) {
+            if (sink.type == EV_ABS) abs_values[abs_lane++] = channels[sink.channel];
+        }
+        if (abs_lane) axes_rescale(abs_values, abs_low, abs_high, abs_out);
+
+        abs_lane = 0;
+        for (auto& sink : sinks) {
+            auto value = channels[sink.channel];
+            switch (sink.type) {
+                break;case EV_ABS: {
+                    auto scaled = abs_out[abs_lane++];
+                    if (sink.rest && value <= 0.f) scaled = *sink.rest;
+                    if (state) state->set(EV_ABS, sink.code, scaled);
+                    else writer->emit(EV_ABS, sink.code, scaled);
+                }
+                break;case EV_KEY:
+                    if (state) state->set(EV_KEY, sink.code, value > 0.5f);
+                    else writer->emit(EV_KEY, sink.code, value > 0.5f);
+                break;case EV_REL: {
+                    auto total = value * sink.scale + sink.remainder;
+                    auto whole = std::trunc(total);
+                    sink.remainder = total - whole;
+                    if (whole) writer->emit(EV_REL, sink.code, int32_t(whole));
+                }
+            }
+        }
+    }
+
+    void Pipeline::operator()(EvInputDevice*, EvDevInputDeviceEventType type, std::span<const input_event>, const EvDevState& device)
+    {
+        if (type == EvDevInputDeviceEventType::DeviceRemoved) return;
+
+        process(device);
+        if (state) state->commit();
+        if (writer->events.empty()) return;
+        writer->sync();
+        writer->flush();
+    }
+
+    void Pipeline::report_profile(std::string_view name)
+    {
+        auto us = [](uint64_t ns) { return double(ns) / 1000.0; };
+
+        for (uint32_t i = 0; i < stage_times.size(); ++i) {
+            auto& times = stage_times[i];
+            if (!times.total) continue;
+            auto& batch = batches[i];
+            auto& first = stages[batch.first];
+            auto& last = stages[batch.first + batch.count - 1];
+            log_info("Pipeline [{}] stages {}-{} ({} -> {}, {} lanes) runs = {} p50 = {:.2f}us p99 = {:.2f}us max = {:.2f}us",
+                name, batch.first, batch.first + batch.count - 1, channel_names[first.in[0]], channel_names[last.out[0]],
+                batch.count, times.total, us(times.percentile(50)), us(times.percentile(99)), us(times.max));
+        }
+    }
+}
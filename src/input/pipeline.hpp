@@ -0,0 +1,131 @@
+#pragma once
+
+#include "evdev_subsystem.hpp"
+#include "uinput_writer.hpp"
+#include "axis_kernels.hpp"
+
+#include <array>
+#include <initializer_list>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace input
+{
+    // Declarative source -> stages -> sink mapping. All values live in a single preallocated array of named
+    //   float channels: sources copy device state into channels, each stage reads and writes channels in
+    //   place, and sinks emit channels to a UInputWriter. Running a frame never copies buffers or allocates.
+    //
+    //   Consecutive deadzone and gamma stages that don't consume each other's outputs are batched and run
+    //   together through axis_kernels.hpp, a lane per stage. EV_ABS sinks are rescaled together likewise.
+    //
+    //   Pipeline joy;
+    //   joy.source(EV_ABS, ABS_Y, "wheel")
+    //      .stage(PipelineStageType::Gamma, {"wheel"}, {"wheel"}, {2.0})
+    //      .sink(EV_ABS, ABS_X, "wheel", 32767);
+    //   evdev->register_input_device_frame_sink(device, joy);
+
+    enum class PipelineStageType : uint8_t
+    {
+        MapRange,       // in -> out, params {in_low, in_high, out_low, out_high, clamp}
+        Deadzone,       // in -> out, params {inner, outer}
+        DeadzoneRadial, // in x, y -> out x, y, params {inner, outer}
+        Gamma,          // in -> out, params {gamma}
+        RadialToWheel,  // in x, y -> out, params {q_max, r_gamma, q_gamma}
+        Accel,          // in x, y -> out x, y, linear speed based acceleration as MouseAccel (Whole), params {offset, accel, mult}
+        Add,            // in a, b -> out
+        Above,          // in -> out (1 or 0), params {threshold}
+        Below,          // in -> out (1 or 0), params {threshold}
+    };
+
+    struct PipelineStage
+    {
+        PipelineStageType type;
+        std::array<uint32_t, 2> in = {};
+        std::array<uint32_t, 2> out = {};
+        std::array<float, 5> params = {};
+    };
+
+    // A run of stages executed together. Vectorized batches gather their stages' inputs into lanes, run one
+    //   kernel and scatter the results, other stage types always form a batch of one.
+    struct PipelineBatch
+    {
+        PipelineStageType type;
+        uint32_t first = 0;
+        uint32_t count = 0;
+
+        // Lanes padded to AxisLanes, empty unless vectorized. Parameters are filled in as stages are added
+        std::vector<float> x, y;
+        std::vector<float> p0, p1;
+    };
+
+    struct Pipeline
+    {
+        // EV_ABS sources read normalized state (see EvDevState), EV_KEY 0 or 1, EV_REL the frame's motion
+        struct Source
+        {
+            uint16_t type;
+            uint16_t code;
+            uint32_t channel;
+        };
+
+        // EV_ABS sinks emit the channel clamped to [-1, 1] times scale, EV_KEY emit 1 above 0.5. EV_REL sinks
+        //   emit channel times scale, carrying the fractional remainder over to the next frame.
+        //   With a state writer, EV_ABS and EV_KEY sinks are staged there and only written when they change.
+        //   EV_ABS sinks with a rest value emit it instead whenever the channel is <= 0.
+        struct Sink
+        {
+            uint16_t type;
+            uint16_t code;
+            uint32_t channel;
+            float scale;
+            std::optional<int32_t> rest;
+            float remainder = 0.f;
+        };
+
+        std::vector<float> channels;
+        std::vector<std::string> channel_names;
+
+        std::vector<Source> sources;
+        std::vector<PipelineStage> stages;
+        std::vector<Sink> sinks;
+
+        std::vector<PipelineBatch> batches;
+
+        // EV_ABS sink lanes for axes_rescale, in sink order
+        std::vector<float> abs_values, abs_low, abs_high;
+        std::vector<int32_t> abs_out;
+
+        UInputWriter* writer = nullptr;
+        UInputStateWriter* state = nullptr;
+
+        // Per batch run time, collected only when enabled
+        std::vector<LatencyHistogram> stage_times;
+
+        explicit Pipeline(UInputWriter* writer = nullptr): writer(writer) {}
+        explicit Pipeline(UInputStateWriter* state): writer(state->writer), state(state) {}
+
+        // Finds or creates a channel by name
+        uint32_t channel(std::string_view name);
+
+        Pipeline& source(uint16_t type, uint16_t code, std::string_view channel);
+        Pipeline& stage(PipelineStageType type, std::initializer_list<std::string_view> in, std::initializer_list<std::string_view> out, std::initializer_list<float> params = {});
+        Pipeline& sink(uint16_t type, uint16_t code, std::string_view channel, float scale = 1.f, std::optional<int32_t> rest = std::nullopt);
+
+        void set_profiling(bool enabled);
+
+        // Runs a single stage against the current channels with scalar math, e.g. to benchmark it in isolation
+        void run_stage(const PipelineStage& stage);
+
+        void run_batch(PipelineBatch& batch);
+
+        // Reads sources, runs every stage and emits sinks to the writer (or stages them), without syncing or flushing
+        void process(const EvDevState& device);
+
+        // Frame sink interface, processes the frame and writes it out as a single report
+        void operator()(EvInputDevice* device, EvDevInputDeviceEventType type, std::span<const input_event> frame, const EvDevState& state);
+
+        void report_profile(std::string_view name);
+    };
+}
@@ -0,0 +1,133 @@
+#pragma once
+
+#include "core.hpp"
+#include "math.hpp"
+
+#include <linux/input.h>
+
+#include <vector>
+
+namespace input
+{
+    // Response curves precomputed over a device's integer axis range, so that an arbitrarily expensive transform
+    //   chain (deadzones, gamma, atan2...) costs a single table lookup per frame. The chain is given as a function
+    //   of the normalized axis value, the same value a consumer would otherwise compute from absinfo.
+    //
+    //   Ranges with up to MaxExactEntries values get one entry per raw value. Larger ranges are sampled at
+    //   SampledEntries points and linearly interpolated. Rebuilding reuses the existing table storage.
+
+    struct ResponseCurve
+    {
+        static constexpr uint32_t MaxExactEntries = 1 << 16;
+        static constexpr uint32_t SampledEntries = 4096;
+
+        int32_t minimum = 0;
+        int32_t maximum = 0;
+        float index_scale = 0.f; // Raw offset to fractional table index
+        bool exact = false;
+        std::vector<float> table;
+
+        bool empty() const { return table.empty(); }
+
+        // fn(normalized) -> output, with raw minimum..maximum mapped to low..high
+        template<typename Fn>
+        void build(const input_absinfo& info, Fn&& fn, float low = -1.f, float high = 1.f)
+        {
+            minimum = info.minimum;
+            maximum = std::max(info.maximum, info.minimum);
+
+            auto range = uint64_t(int64_t(maximum) - minimum);
+            exact = range < MaxExactEntries;
+            auto entries = exact ? uint32_t(range + 1) : SampledEntries;
+            table.resize(entries);
+            index_scale = range ? float(entries - 1) / float(range) : 0.f;
+
+            for (uint32_t i = 0; i < entries; ++i) {
+                auto t = entries > 1 ? double(i) / (entries - 1) : 0.0;
+                table[i] = float(fn(low + t * (high - low)));
+            }
+        }
+
+        float operator()(int32_t raw) const
+        {
+            auto offset = uint32_t(int64_t(std::clamp(raw, minimum, maximum)) - minimum);
+            if (exact) return table[offset];
+
+            auto pos = float(offset) * index_scale;
+            auto i = std::min(uint32_t(pos), uint32_t(table.size() - 2));
+            auto f = pos - float(i);
+            return table[i] + (table[i + 1] - table[i]) * f;
+        }
+    };
+
+    // Two axis variant for transforms that combine a pair, e.g. a stick mapped through radial_to_wheel.
+    //   Exact when the product of both ranges is small (e.g. 8-bit sticks), otherwise bilinearly interpolated
+    //   over a SampledSide x SampledSide grid.
+
+    struct ResponseCurve2D
+    {
+        static constexpr uint32_t MaxExactEntries = 1 << 18;
+        static constexpr uint32_t SampledSide = 256;
+
+        struct Axis
+        {
+            int32_t minimum = 0;
+            int32_t maximum = 0;
+            uint32_t entries = 0;
+            float index_scale = 0.f;
+
+            uint64_t range() const { return uint64_t(int64_t(maximum) - minimum); }
+        };
+
+        Axis x, y;
+        bool exact = false;
+        std::vector<float> table; // Row major, y rows of x entries
+
+        bool empty() const { return table.empty(); }
+
+        // fn(vec2 normalized) -> output, with each raw range mapped to [-1, 1]
+        template<typename Fn>
+        void build(const input_absinfo& x_info, const input_absinfo& y_info, Fn&& fn)
+        {
+            x = Axis { x_info.minimum, std::max(x_info.maximum, x_info.minimum) };
+            y = Axis { y_info.minimum, std::max(y_info.maximum, y_info.minimum) };
+
+            // (x.range() + 1) * (y.range() + 1) <= MaxExactEntries, without overflowing on full 32 bit ranges
+            exact = x.range() < MaxExactEntries && y.range() < MaxExactEntries / (x.range() + 1);
+            for (auto axis : { &x, &y }) {
+                axis->entries = exact ? uint32_t(axis->range() + 1) : SampledSide;
+                axis->index_scale = axis->range() ? float(axis->entries - 1) / float(axis->range()) : 0.f;
+            }
+            table.resize(size_t(x.entries) * y.entries);
+
+            auto normalized = [](uint32_t i, uint32_t entries) {
+                return entries > 1 ? -1.0 + 2.0 * double(i) / (entries - 1) : 0.0;
+            };
+            for (uint32_t j = 0; j < y.entries; ++j) {
+                for (uint32_t i = 0; i < x.entries; ++i) {
+                    table[size_t(j) * x.entries + i] = float(fn(vec2(normalized(i, x.entries), normalized(j, y.entries))));
+                }
+            }
+        }
+
+        float operator()(int32_t raw_x, int32_t raw_y) const
+        {
+            auto ox = uint32_t(int64_t(std::clamp(raw_x, x.minimum, x.maximum)) - x.minimum);
+            auto oy = uint32_t(int64_t(std::clamp(raw_y, y.minimum, y.maximum)) - y.minimum);
+            if (exact) return table[size_t(oy) * x.entries + ox];
+
+            auto px = float(ox) * x.index_scale;
+            auto py = float(oy) * y.index_scale;
+            auto i = std::min(uint32_t(px), x.entries - 2);
+            auto j = std::min(uint32_t(py), y.entries - 2);
+            auto fx = px - float(i);
+            auto fy = py - float(j);
+
+            auto row0 = &table[size_t(j) * x.entries + i];
+            auto row1 = row0 + x.entries;
+            auto top = row0[0] + (row0[1] - row0[0]) * fx;
+            auto bottom = row1[0] + (row1[1] - row1[0]) * fx;
+            return top + (bottom - top) * fy;
+        }
+    };
+}
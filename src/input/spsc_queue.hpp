@@ -0,0 +1,68 @@
+#pragma once
+
+#include "core.hpp"
+
+#include <atomic>
+#include <bit>
+#include <memory>
+#include <new>
+#include <span>
+
+namespace input
+{
+    // Bounded lock-free single-producer single-consumer ring buffer.
+    //   Reads and writes are exposed as contiguous spans so that bulk transfers (e.g. a read()
+    //   straight into the queue) avoid intermediate copies. Spans stop at the wrap point.
+
+    template<typename T>
+    struct SpscQueue
+    {
+        static_assert(std::is_trivially_copyable_v<T>);
+
+        static constexpr size_t CacheLine = 64;
+
+        std::unique_ptr<T[]> buffer;
+        uint32_t capacity = 0;
+
+        // Free running positions, masked on access
+        alignas(CacheLine) std::atomic<uint32_t> head = 0; // Written by consumer
+        alignas(CacheLine) std::atomic<uint32_t> tail = 0; // Written by producer
+
+        SpscQueue(uint32_t _capacity)
+            : buffer(new T[std::bit_ceil(_capacity)])
+            , capacity(std::bit_ceil(_capacity))
+        {}
+
+        std::span<T> prepare_write()
+        {
+            auto t = tail.load(std::memory_order_relaxed);
+            auto h = head.load(std::memory_order_acquire);
+            auto offset = t & (capacity - 1);
+            auto free = capacity - (t - h);
+            return { buffer.get() + offset, std::min(free, capacity - offset) };
+        }
+
+        void commit_write(uint32_t count)
+        {
+            tail.store(tail.load(std::memory_order_relaxed) + count, std::memory_order_release);
+        }
+
+        std::span<const T> prepare_read()
+        {
+            auto h = head.load(std::memory_order_relaxed);
+            auto t = tail.load(std::memory_order_acquire);
+            auto offset = h & (capacity - 1);
+            return { buffer.get() + offset, std::min(t - h, capacity - offset) };
+        }
+
+        void commit_read(uint32_t count)
+        {
+            head.store(head.load(std::memory_order_relaxed) + count, std::memory_order_release);
+        }
+
+        bool empty()
+        {
+            return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+        }
+    };
+}
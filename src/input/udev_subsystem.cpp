@@ -4,6 +4,10 @@
 #include <limits.h>
 #include <sys/stat.h>
 
+#include <atomic>
+#include <exception>
+#include <span>
+#include <thread>
 #include <unordered_set>
 
 #define UDEV_TRACE_EVENTS 0
@@ -15,8 +19,12 @@ namespace input
         udev_monitor* mon = nullptr;
         std::unordered_set<std::string> subsystems;
         std::vector<UDeviceCallbackFn> device_callbacks;
+        std::vector<UDeviceProbeFn> device_probes; // Parallel to device_callbacks
 
         std::unordered_map<std::string, UDevHidDevice> hid_devices;
+
+        // Contexts used by initial scan workers, kept for as long as the devices created in them
+        std::vector<udev*> probe_contexts;
     };
 
     UDevSubsystem* UDevSubsystem::create()
@@ -38,6 +46,7 @@ namespace input
 
         udev_monitor_unref(self->mon);
         udev_unref(self->ud);
+        for (auto ud : self->probe_contexts) udev_unref(ud);
 
         delete self;
     }
@@ -65,8 +74,65 @@ namespace input
 
     namespace
     {
-        void handle_device_added(UDevSubsystem::Impl* self, udev_device* dev)
+        // Everything about an added node that can be gathered without touching subsystem state, so that
+        //   the initial scan can run it on worker threads
+
+        struct ProbedNode
         {
+            udev_device* dev = nullptr;
+            udev_device* hid = nullptr; // Unset if the node is not of interest
+
+            udev_device* usb_device = nullptr;
+            udev_device* usb_interface = nullptr;
+            std::optional<UDevHidDevice::UsbInfo> usb_info;
+
+            // One per listener
+            std::vector<std::unique_ptr<UDevProbeResult>> probes;
+
+            std::exception_ptr error;
+        };
+
+        void probe_node(UDevSubsystem::Impl* self, ProbedNode& probed)
+        {
+            auto dev = probed.dev;
+
+            auto hid = udev_device_get_parent_with_subsystem_devtype(dev, "hid", nullptr);
+            if (!hid) return;
+
+            if (!udev_device_get_devnode(dev)) return;
+
+            // Parents belong to dev, so nothing here is shared with nodes probed on other threads
+
+            probed.usb_device = udev_device_get_parent_with_subsystem_devtype(hid, "usb", "usb_device");
+            if (probed.usb_device) {
+                probed.usb_info = UDevHidDevice::UsbInfo {
+                    .manufacturer = udev_device_get_sysattr_value(probed.usb_device, "manufacturer") ?: "",
+                    .product_str = udev_device_get_sysattr_value(probed.usb_device, "product") ?: "",
+                    .vendor_id = uint32_t(strtol(udev_device_get_sysattr_value(probed.usb_device, "idVendor") ?: "", nullptr, 16)),
+                    .product_id = uint32_t(strtol(udev_device_get_sysattr_value(probed.usb_device, "idProduct") ?: "", nullptr, 16)),
+                    .version = uint32_t(strtol(udev_device_get_sysattr_value(probed.usb_device, "bcdDevice") ?: "", nullptr, 16)),
+                };
+
+                probed.usb_interface = udev_device_get_parent_with_subsystem_devtype(hid, "usb", "usb_interface");
+                if (probed.usb_interface) {
+                    probed.usb_info->interface_number = atoi(udev_device_get_sysattr_value(probed.usb_interface, "bInterfaceNumber"));
+                }
+            }
+
+            probed.probes.resize(self->device_probes.size());
+            for (uint32_t i = 0; i < self->device_probes.size(); ++i) {
+                if (self->device_probes[i]) probed.probes[i] = self->device_probes[i](dev);
+            }
+
+            probed.hid = hid;
+        }
+
+        void commit_node(UDevSubsystem::Impl* self, ProbedNode& probed)
+        {
+            if (probed.error) std::rethrow_exception(probed.error);
+
+            auto dev = probed.dev;
+
 #if UDEV_TRACE_EVENTS
             if (udev_device_get_devnode(dev)) {
                 log_trace("+ {}", udev_device_get_syspath(dev));
@@ -78,30 +144,14 @@ namespace input
             }
 #endif
 
-            auto hid = udev_device_get_parent_with_subsystem_devtype(dev, "hid", nullptr);
-            if (!hid) return;
-
-            if (!udev_device_get_devnode(dev)) return;
+            if (!probed.hid) return;
 
-            auto& device = self->hid_devices[udev_device_get_syspath(hid)];
+            auto& device = self->hid_devices[udev_device_get_syspath(probed.hid)];
             if (!device.hid) {
-                device.hid = udev_device_ref(hid);
-
-                device.usb_device = udev_device_get_parent_with_subsystem_devtype(hid, "usb", "usb_device");
-                if (device.usb_device) {
-                    device.usb_info = UDevHidDevice::UsbInfo {
-                        .manufacturer = udev_device_get_sysattr_value(device.usb_device, "manufacturer") ?: "",
-                        .product_str = udev_device_get_sysattr_value(device.usb_device, "product") ?: "",
-                        .vendor_id = uint32_t(strtol(udev_device_get_sysattr_value(device.usb_device, "idVendor") ?: "", nullptr, 16)),
-                        .product_id = uint32_t(strtol(udev_device_get_sysattr_value(device.usb_device, "idProduct") ?: "", nullptr, 16)),
-                        .version = uint32_t(strtol(udev_device_get_sysattr_value(device.usb_device, "bcdDevice") ?: "", nullptr, 16)),
-                    };
-
-                    device.usb_interface = udev_device_get_parent_with_subsystem_devtype(hid, "usb", "usb_interface");
-                    if (device.usb_interface) {
-                        device.usb_info->interface_number = atoi(udev_device_get_sysattr_value(device.usb_interface, "bInterfaceNumber"));
-                    }
-                }
+                device.hid = udev_device_ref(probed.hid);
+                device.usb_device = probed.usb_device;
+                device.usb_interface = probed.usb_interface;
+                device.usb_info = std::move(probed.usb_info);
 
                 for (auto& cb : self->device_callbacks) {
                     cb(UDeviceEvent {
@@ -120,15 +170,54 @@ namespace input
                 hide_udev_node(dev);
             }
 
-            for (auto& cb : self->device_callbacks) {
-                cb(UDeviceEvent {
+            for (uint32_t i = 0; i < self->device_callbacks.size(); ++i) {
+                self->device_callbacks[i](UDeviceEvent {
                     .action = UDevAction::AddNode,
                     .device = &device,
                     .node = &interface,
+                    .probe = probed.probes[i].get(),
                 });
             }
         }
 
+        void handle_device_added(UDevSubsystem::Impl* self, udev_device* dev)
+        {
+            ProbedNode probed { .dev = dev };
+            probe_node(self, probed);
+            commit_node(self, probed);
+        }
+
+        // Creates and probes each device on a pool of worker threads. A libudev context must not be used from
+        //   several threads at once, so each worker creates devices (and walks their parents) in its own context.
+
+        void probe_nodes_parallel(UDevSubsystem::Impl* self, std::span<const char* const> syspaths, std::span<ProbedNode> nodes, uint32_t thread_count)
+        {
+            for (uint32_t i = 1; i < thread_count; ++i) {
+                auto ud = udev_new();
+                if (!ud) raise_unix_error("udev_new");
+                self->probe_contexts.emplace_back(ud);
+            }
+
+            std::atomic<uint32_t> next = 0;
+            auto work = [&](udev* ud) {
+                for (uint32_t i; (i = next.fetch_add(1, std::memory_order_relaxed)) < syspaths.size();) {
+                    auto& probed = nodes[i];
+                    try {
+                        probed.dev = udev_device_new_from_syspath(ud, syspaths[i]);
+                        if (probed.dev) probe_node(self, probed);
+                    } catch (...) {
+                        probed.error = std::current_exception();
+                    }
+                }
+            };
+
+            std::vector<std::jthread> workers;
+            for (uint32_t i = 1; i < thread_count; ++i) {
+                workers.emplace_back(work, self->probe_contexts[self->probe_contexts.size() - thread_count + i]);
+            }
+            work(self->ud);
+        }
+
         void handle_device_removed(UDevSubsystem::Impl* self, udev_device* dev)
         {
             for (auto&[syspath, device] : self->hid_devices) {
@@ -184,12 +273,15 @@ namespace input
         get_impl(this)->subsystems.emplace(subsystem);
     }
 
-    void UDevSubsystem::register_device_listener(UDeviceCallbackFn&& fn)
+    void UDevSubsystem::register_device_listener(UDeviceCallbackFn&& fn, UDeviceProbeFn&& probe)
     {
-        get_impl(this)->device_callbacks.emplace_back(std::move(fn));
+        decl_self(this);
+
+        self->device_callbacks.emplace_back(std::move(fn));
+        self->device_probes.emplace_back(std::move(probe));
     }
 
-    void UDevSubsystem::start(FdEventBus* bus)
+    void UDevSubsystem::start(FdEventBus* bus, uint32_t probe_threads)
     {
         decl_self(this);
 
@@ -218,14 +310,27 @@ namespace input
         }
         udev_enumerate_scan_devices(enumerate);
 
+        std::vector<const char*> syspaths;
         auto devices = udev_enumerate_get_list_entry(enumerate);
         udev_list_entry* entry;
         udev_list_entry_foreach(entry, devices) {
-            auto path = udev_list_entry_get_name(entry);
-            auto dev = udev_device_new_from_syspath(self->ud, path);
-            defer { udev_device_unref(dev); };
+            syspaths.emplace_back(udev_list_entry_get_name(entry));
+        }
+
+        // Probe concurrently, then commit serially so listeners observe devices in enumeration order
+
+        std::vector<ProbedNode> nodes(syspaths.size());
+        defer {
+            for (auto& probed : nodes) udev_device_unref(probed.dev);
+        };
+
+        if (!probe_threads) probe_threads = std::max(1u, std::thread::hardware_concurrency());
+        probe_threads = std::min(probe_threads, uint32_t(syspaths.size()));
+        log_debug("Probing {} devices on {} threads", syspaths.size(), probe_threads);
+        probe_nodes_parallel(self, syspaths, nodes, probe_threads);
 
-            handle_device_added(self, dev);
+        for (auto& probed : nodes) {
+            if (probed.dev || probed.error) commit_node(self, probed);
         }
     }
 }
@@ -4,7 +4,9 @@
 
 #include <libudev.h>
 
+#include <functional>
 #include <list>
+#include <memory>
 
 namespace input
 {
@@ -55,14 +57,28 @@ namespace input
         void hide();
     };
 
+    // Base for per-listener data gathered by a UDeviceProbeFn
+    struct UDevProbeResult
+    {
+        virtual ~UDevProbeResult() = default;
+    };
+
     struct UDeviceEvent
     {
         UDevAction action;
         UDevHidDevice* device;
         UDevHidNode* node;
+
+        // AddNode only, the listener's own probe result (if it registered a probe). Owned by the subsystem
+        //   for the duration of the callback, listeners may move out of it.
+        UDevProbeResult* probe = nullptr;
     };
 
-    using UDeviceCallbackFn = std::function<void(UDeviceEvent)>;
+    using UDeviceCallbackFn = InplaceFunction<void(UDeviceEvent)>;
+
+    // Expensive per node work (opening device nodes, ioctls) that does not depend on listener state. During the
+    //   initial scan probes run concurrently on worker threads, so they must only touch the given device.
+    using UDeviceProbeFn = std::function<std::unique_ptr<UDevProbeResult>(udev_device*)>;
 
     struct UDevSubsystem : RefCounted
     {
@@ -73,8 +89,10 @@ namespace input
 
     public:
         void watch_subsystem(std::string_view subsystem);
-        void register_device_listener(UDeviceCallbackFn&&);
+        void register_device_listener(UDeviceCallbackFn&&, UDeviceProbeFn&& = {});
 
-        void start(FdEventBus* bus);
+        // Enumerates existing devices, probing them on up to probe_threads workers (0 = one per core).
+        //   Callbacks are always invoked on the calling thread, in enumeration order.
+        void start(FdEventBus* bus, uint32_t probe_threads = 0);
     };
 }
@@ -0,0 +1,97 @@
+#include "uinput_writer.hpp"
+#include "latency_histogram.hpp"
+
+#include <unistd.h>
+
+namespace input
+{
+    UInputWriter::UInputWriter(int fd, FdEventBus* bus)
+        : fd(fd)
+        , bus(bus)
+    {
+        events.reserve(64);
+    }
+
+    UInputWriter::UInputWriter(libevdev_uinput* uinput, FdEventBus* bus)
+        : UInputWriter(libevdev_uinput_get_fd(uinput), bus)
+    {}
+
+    void UInputWriter::flush()
+    {
+        if (events.empty()) return;
+        defer {
+            events.clear();
+            latency_record_forwarded();
+        };
+
+        // Timestamps are left zeroed, uinput stamps events on injection
+
+        if (bus) {
+            bus->write(fd, std::as_bytes(std::span(events)));
+            return;
+        }
+
+        auto data = reinterpret_cast<const char*>(events.data());
+        size_t size = events.size() * sizeof(input_event);
+        while (size) {
+            auto written = unix_check_n1(write(fd, data, size), EINTR);
+            if (written <= 0) continue;
+            data += written;
+            size -= written;
+        }
+    }
+
+    void UInputWriter::reset(int _fd)
+    {
+        // Writes already queued on the bus must be submitted while the old fd is still open
+        if (bus && fd != -1) bus->flush_writes(fd);
+
+        fd = _fd;
+        events.clear();
+    }
+
+// -----------------------------------------------------------------------------
+
+    bool UInputStateWriter::commit()
+    {
+        if (bus) return false;
+        return write();
+    }
+
+    void UInputStateWriter::set_fixed_rate(FdEventBus* _bus, std::chrono::steady_clock::duration period)
+    {
+        if (bus) bus->cancel(timer);
+        bus = nullptr;
+        if (period == std::chrono::steady_clock::duration::zero()) return;
+
+        bus = _bus;
+        timer = bus->schedule_every(period, [this] { write(); });
+    }
+
+    bool UInputStateWriter::write()
+    {
+        // Toggled keys first report the state they passed through, in a report of their own
+        bool toggled = false;
+        for (auto& slot : slots) {
+            if (!slot.toggled) continue;
+            slot.toggled = false;
+            slot.written = !slot.written;
+            writer->emit(slot.type, slot.code, slot.written);
+            toggled = true;
+        }
+        if (toggled) writer->sync();
+
+        bool changed = false;
+        for (auto& slot : slots) {
+            if (slot.value == slot.written) continue;
+            writer->emit(slot.type, slot.code, slot.value);
+            slot.written = slot.value;
+            changed = true;
+        }
+        if (changed) writer->sync();
+
+        if (!toggled && !changed) return false;
+        writer->flush();
+        return true;
+    }
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include "fd_event_bus.hpp"
+
+#include <libevdev/libevdev-uinput.h>
+
+#include <chrono>
+#include <span>
+#include <vector>
+
+namespace input
+{
+    // Collects output events into a contiguous buffer and hands them to the kernel in a single write.
+    //   The uinput driver accepts any whole number of input_events per write, so a complete frame
+    //   (or a complete macro spanning several frames) costs one syscall instead of one per event.
+    //   If a bus is provided, writes are routed through it so they can be batched with its reads.
+
+    struct UInputWriter
+    {
+        int fd = -1;
+        FdEventBus* bus = nullptr;
+        std::vector<input_event> events;
+
+        UInputWriter() = default;
+        UInputWriter(int fd, FdEventBus* bus = nullptr);
+        UInputWriter(libevdev_uinput* uinput, FdEventBus* bus = nullptr);
+
+        void emit(uint16_t type, uint16_t code, int32_t value)
+        {
+            events.emplace_back(input_event {
+                .type = type,
+                .code = code,
+                .value = value,
+            });
+        }
+
+        // Appends pre-encoded events, e.g. a macro
+        void append(std::span<const input_event> sequence)
+        {
+            events.insert(events.end(), sequence.begin(), sequence.end());
+        }
+
+        void sync()
+        {
+            emit(EV_SYN, SYN_REPORT, 0);
+        }
+
+        void flush();
+
+        // Call before closing the current fd, see FdEventBus::flush_writes
+        void reset(int fd = -1);
+    };
+
+    // Keeps the last value written for each absolute axis and key of a virtual device, so that full state reports
+    //   only emit the codes that changed and a report that changes nothing writes nothing at all. Values are
+    //   staged with set() and written out by commit(), or by a timer at a fixed rate once one is started.
+    //   Codes start out as 0, the state of a freshly created device.
+
+    struct UInputStateWriter
+    {
+        struct Slot
+        {
+            uint16_t type;
+            uint16_t code;
+            int32_t value;
+            int32_t written;
+            bool toggled = false; // Key changed and returned to its written value since the last write
+        };
+
+        UInputWriter* writer = nullptr;
+        std::vector<Slot> slots;
+
+        FdEventBus* bus = nullptr;
+        TimerHandle timer;
+
+        UInputStateWriter() = default;
+        explicit UInputStateWriter(UInputWriter* writer): writer(writer) {}
+
+        UInputStateWriter(const UInputStateWriter&) = delete;
+        UInputStateWriter& operator=(const UInputStateWriter&) = delete;
+
+        // EV_ABS or EV_KEY. Axes only ever send their latest value. A key that changes back before the next
+        //   write is replayed as its own report ahead of the final state, so short taps are never lost (repeated
+        //   taps within one write are reported as one)
+        void set(uint16_t type, uint16_t code, int32_t value)
+        {
+            for (auto& slot : slots) {
+                if (slot.type == type && slot.code == code) {
+                    if (type == EV_KEY && slot.value != slot.written && value == slot.written) slot.toggled = true;
+                    slot.value = value;
+                    return;
+                }
+            }
+            slots.emplace_back(Slot { type, code, value, 0 });
+        }
+
+        // Writes changed codes as a single report, unless a fixed rate is running. Returns whether anything was written
+        bool commit();
+
+        // Writes on a timer instead of on commit(), decoupling output rate from input rate. A zero period stops it.
+        //   The timer lives on the bus, stop it before the state writer goes away
+        void set_fixed_rate(FdEventBus* bus, std::chrono::steady_clock::duration period);
+
+        // Writes changed codes now, regardless of rate
+        bool write();
+    };
+}